@@ -1,16 +1,56 @@
 // To implement a program to identify and count the number of  Keywords, Identifiers, Operators and Constants for a given input Program.
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
-const unordered_set<string> keywords = {
+enum class Keyword : unsigned char
+{
+    None, Alignas, Alignof, And, AndEq, Asm, Auto, Bitand, Bitor, Bool, Break, Case, Catch,
+    Char, Char8T, Char16T, Char32T, Class, Compl, Concept, Const, Consteval, Constexpr,
+    Constinit, ConstCast, Continue, CoAwait, CoReturn, CoYield, Decltype, Default, Delete,
+    Do, Double, DynamicCast, Else, Enum, Explicit, Export, Extern, False, Float, For,
+    Friend, Goto, If, Inline, Int, Long, Mutable, Namespace, New, Noexcept, Not, NotEq,
+    Nullptr, Operator, Or, OrEq, Private, Protected, Public, Reflexpr, Register,
+    ReinterpretCast, Requires, Return, Short, Signed, Sizeof, Static, StaticAssert,
+    StaticCast, Struct, Switch, Synchronized, Template, This, ThreadLocal, Throw, True,
+    Try, Typedef, Typeid, Typename, Union, Unsigned, Using, Virtual, Void, Volatile,
+    WcharT, While, Xor, XorEq, Include, Main, Cout, Cin, Std
+};
+
+// Spellings in Keyword order, without Keyword::None
+constexpr string_view keywordNames[] = {
     "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool",
     "break", "case", "catch", "char", "char8_t", "char16_t", "char32_t", "class",
     "compl", "concept", "const", "consteval", "constexpr", "constinit", "const_cast",
@@ -24,12 +64,66 @@ const unordered_set<string> keywords = {
     "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
     "wchar_t", "while", "xor", "xor_eq", "include", "main", "cout", "cin", "std"};
 
+// Perfect hash over keywordNames: the seed is searched at compile time so
+// that every keyword lands in its own slot, and a lookup is one hash, one
+// table probe and one compare, with no allocation.
+constexpr size_t KEYWORD_SLOTS = 1024;
+constexpr size_t MAX_KEYWORD_LEN = 16;
+
+constexpr uint32_t keywordHash(string_view word, uint32_t seed)
+{
+    uint32_t h = seed ^ (uint32_t)word.size();
+    for (char c : word)
+        h = (h ^ (unsigned char)c) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+struct KeywordTable
+{
+    uint32_t seed;
+    array<unsigned char, KEYWORD_SLOTS> slot; // Keyword value, 0 if empty
+};
+
+constexpr KeywordTable buildKeywordTable()
+{
+    for (uint32_t seed = 1;; ++seed)
+    {
+        KeywordTable table{seed, {}};
+        bool collision = false;
+        for (size_t i = 0; i < size(keywordNames) && !collision; ++i)
+        {
+            auto &slot = table.slot[keywordHash(keywordNames[i], seed) % KEYWORD_SLOTS];
+            if (slot)
+                collision = true;
+            else
+                slot = (unsigned char)(i + 1);
+        }
+        if (!collision)
+            return table;
+    }
+}
+
+constexpr KeywordTable keywordTable = buildKeywordTable();
+
+constexpr Keyword classifyKeyword(string_view word)
+{
+    if (word.size() < 2 || word.size() > MAX_KEYWORD_LEN)
+        return Keyword::None;
+    unsigned char k = keywordTable.slot[keywordHash(word, keywordTable.seed) % KEYWORD_SLOTS];
+    if (k && keywordNames[k - 1] == word)
+        return Keyword(k);
+    return Keyword::None;
+}
+
+static_assert(size(keywordNames) == size_t(Keyword::Std), "keywordNames must follow Keyword order");
+static_assert(classifyKeyword("while") == Keyword::While && classifyKeyword("Std") == Keyword::None);
+
 const unordered_set<char> single_char_operators = {
     '+', '-', '*', '/', '%', '=', '>', '<', '!', '&', '|', '^', '~', '?', ':'};
 
-bool isKeyword(const string &token)
+bool isKeyword(string_view token)
 {
-    return keywords.count(token);
+    return classifyKeyword(token) != Keyword::None;
 }
 
 bool isOperator(char ch)
@@ -37,7 +131,7 @@ bool isOperator(char ch)
     return single_char_operators.count(ch);
 }
 
-bool isNumericConstant(const string &token)
+bool isNumericConstant(string_view token)
 {
     if (token.empty())
     {
@@ -62,7 +156,7 @@ bool isNumericConstant(const string &token)
     return true;
 }
 
-bool isIdentifier(const string &token)
+bool isIdentifier(string_view token)
 {
     if (token.empty() || isKeyword(token) || isdigit(token[0]))
     {
@@ -80,22 +174,34 @@ bool isIdentifier(const string &token)
     return true;
 }
 
-void analyzeFile(const string &filename)
+struct TokenCounts
 {
-    ifstream file(filename);
-    if (!file.is_open())
-    {
-        cerr << "Error: Could not open file '" << filename << "' for analysis." << endl;
-        return;
-    }
+    long long keywords = 0;
+    long long identifiers = 0;
+    long long operators = 0;
+    long long constants = 0;
+};
 
-    cout << "Analyzing file: " << filename << "\n";
+bool operator==(const TokenCounts &a, const TokenCounts &b)
+{
+    return a.keywords == b.keywords && a.identifiers == b.identifiers &&
+           a.operators == b.operators && a.constants == b.constants;
+}
 
-    int keywordCount = 0;
-    int identifierCount = 0;
-    int operatorCount = 0;
-    int constantCount = 0;
+void classifyToken(string_view token, TokenCounts &counts)
+{
+    if (isKeyword(token))
+        counts.keywords++;
+    else if (isNumericConstant(token))
+        counts.constants++;
+    else if (isIdentifier(token))
+        counts.identifiers++;
+}
 
+// Original line-by-line scanner, kept as the reference for the benchmark
+TokenCounts countTokensGetline(ifstream &file)
+{
+    TokenCounts counts;
     string line;
     string currentToken = "";
     bool in_multiline_comment = false;
@@ -121,64 +227,31 @@ void analyzeFile(const string &filename)
                 continue;
             }
 
-            if (i + 1 < line.length() && ch == '/' && line[i + 1] == '/')
-            {
-                // single line comment, skip the rest of the line
-            }
-
             if (ch == '"')
             {
-                constantCount++;
+                counts.constants++;
                 size_t end_quote = line.find('"', i + 1);
                 if (end_quote != string::npos)
                 {
                     i = end_quote;
                 }
-                else
-                {
-                }
                 continue;
             }
 
             if (ch == '\'')
             {
-                constantCount++;
-                if (i + 2 < line.length() && line[i + 2] == '\'')
-                {
-                }
-                else if (i + 3 < line.length() && line[i + 1] == '\\' && line[i + 3] == '\'')
-                {
-                }
+                counts.constants++;
                 continue;
             }
 
-            auto processToken = [&]()
+            if (isOperator(ch))
             {
                 if (!currentToken.empty())
                 {
-                    if (isKeyword(currentToken))
-                        keywordCount++;
-                    else if (isNumericConstant(currentToken))
-                        constantCount++;
-                    else if (isIdentifier(currentToken))
-                        identifierCount++;
+                    classifyToken(currentToken, counts);
                     currentToken = "";
                 }
-            };
-
-            if (isOperator(ch))
-            {
-                processToken();
-                operatorCount++;
-                if (i + 1 < line.length())
-                {
-                    char next_ch = line[i + 1];
-                    if ((ch == '=' && next_ch == '=') || (ch == '!' && next_ch == '=') ||
-                        (ch == '>' && next_ch == '=') || (ch == '<' && next_ch == '=') ||
-                        (ch == '&' && next_ch == '&') || (ch == '|' && next_ch == '|'))
-                    {
-                    }
-                }
+                counts.operators++;
                 continue;
             }
 
@@ -186,7 +259,11 @@ void analyzeFile(const string &filename)
                 ch == '}' || ch == '[' || ch == ']' || ch == ';' || ch == ',' ||
                 ch == '#')
             {
-                processToken();
+                if (!currentToken.empty())
+                {
+                    classifyToken(currentToken, counts);
+                    currentToken = "";
+                }
             }
             else
             {
@@ -195,29 +272,821 @@ void analyzeFile(const string &filename)
         }
         if (!currentToken.empty())
         {
-            if (isKeyword(currentToken))
-                keywordCount++;
-            else if (isNumericConstant(currentToken))
-                constantCount++;
-            else if (isIdentifier(currentToken))
-                identifierCount++;
+            classifyToken(currentToken, counts);
             currentToken = "";
         }
     }
+    return counts;
+}
+
+// Byte-search kernels used by the mapped scanner. Each returns the first
+// position in [p, end) that matches, or end. The SSE2/AVX2 versions test 16
+// or 32 bytes per step and finish the tail with the scalar version.
+
+inline bool isSpaceByte(unsigned char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+const char *skipSpacesScalar(const char *p, const char *end)
+{
+    while (p < end && isSpaceByte((unsigned char)*p))
+        ++p;
+    return p;
+}
+
+const char *findEitherScalar(const char *p, const char *end, char a, char b)
+{
+    while (p < end && *p != a && *p != b)
+        ++p;
+    return p;
+}
+
+// Position of the '*' in the first "*/"
+const char *findCommentCloseScalar(const char *p, const char *end)
+{
+    while (p + 1 < end && !(p[0] == '*' && p[1] == '/'))
+        ++p;
+    return p + 1 < end ? p : end;
+}
+
+#if defined(__SSE2__)
+// 0xFF in every lane holding ' ' or '\t'..'\r'
+inline __m128i spaceLanes(__m128i v)
+{
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(shifted, _mm_set1_epi8(4)), _mm_set1_epi8(4));
+    return _mm_or_si128(control, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+#endif
+
+#if defined(__AVX2__)
+inline __m256i spaceLanes(__m256i v)
+{
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_max_epu8(shifted, _mm256_set1_epi8(4)), _mm256_set1_epi8(4));
+    return _mm256_or_si256(control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+#endif
+
+const char *skipSpaces(const char *p, const char *end)
+{
+#if defined(__AVX2__)
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(spaceLanes(v));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        uint32_t mask = ~(uint32_t)_mm_movemask_epi8(spaceLanes(v)) & 0xFFFF;
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+    return skipSpacesScalar(p, end);
+}
+
+const char *findEither(const char *p, const char *end, char a, char b)
+{
+#if defined(__AVX2__)
+    const __m256i wideA = _mm256_set1_epi8(a), wideB = _mm256_set1_epi8(b);
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, wideA), _mm256_cmpeq_epi8(v, wideB)));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i narrowA = _mm_set1_epi8(a), narrowB = _mm_set1_epi8(b);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, narrowA), _mm_cmpeq_epi8(v, narrowB)));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+    return findEitherScalar(p, end, a, b);
+}
+
+const char *findCommentClose(const char *p, const char *end)
+{
+    // Compare the block with '*' and the block one byte later with '/'
+#if defined(__AVX2__)
+    const __m256i wideStar = _mm256_set1_epi8('*'), wideSlash = _mm256_set1_epi8('/');
+    for (; end - p > 32; p += 32)
+    {
+        __m256i star = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), wideStar);
+        __m256i slash = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1)), wideSlash);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(star, slash));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i narrowStar = _mm_set1_epi8('*'), narrowSlash = _mm_set1_epi8('/');
+    for (; end - p > 16; p += 16)
+    {
+        __m128i star = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), narrowStar);
+        __m128i slash = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1)), narrowSlash);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(star, slash));
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+    return findCommentCloseScalar(p, end);
+}
+
+// Byte classes for the mapped scanner: one table lookup replaces the chain of
+// character tests in the getline loop.
+enum CharClass : unsigned char
+{
+    CC_WORD,     // part of a keyword, identifier or number
+    CC_BREAK,    // whitespace and ( ) { } [ ] ; , #
+    CC_OPERATOR, // single_char_operators except '/'
+    CC_SLASH,    // '/' may open a block comment
+    CC_DQUOTE,
+    CC_SQUOTE
+};
+
+const array<unsigned char, 256> charClass = []
+{
+    array<unsigned char, 256> table{};
+    table.fill(CC_WORD);
+    for (unsigned char c : string_view(" \t\n\v\f\r(){}[];,#"))
+        table[c] = CC_BREAK;
+    for (char c : single_char_operators)
+        table[(unsigned char)c] = CC_OPERATOR;
+    table['/'] = CC_SLASH;
+    table['"'] = CC_DQUOTE;
+    table['\''] = CC_SQUOTE;
+    return table;
+}();
+
+// Lex the bytes in [p, end) and add them to counts. The rules match
+// countTokensGetline exactly: a newline behaves like the end of a getline line,
+// so string literals and operator lookahead never cross it. inComment carries
+// an open block comment in and out of the call.
+void scanBuffer(const char *p, const char *end, TokenCounts &counts, bool &inComment)
+{
+    // The current token is a slice of the buffer; a quote or comment in the
+    // middle of a token breaks the slice, so earlier pieces go to spill.
+    const char *tokBegin = nullptr;
+    const char *tokEnd = nullptr;
+    string spill;
+
+    auto flushToken = [&]()
+    {
+        if (!tokBegin)
+            return;
+        if (spill.empty())
+        {
+            classifyToken(string_view(tokBegin, tokEnd - tokBegin), counts);
+        }
+        else
+        {
+            spill.append(tokBegin, tokEnd);
+            classifyToken(spill, counts);
+            spill.clear();
+        }
+        tokBegin = nullptr;
+    };
+
+    while (p < end)
+    {
+        if (inComment)
+        {
+            // Stop on the '*' of "*/"; the '/' is then lexed as an operator,
+            // just like the line loop does.
+            p = findCommentClose(p, end);
+            if (p == end)
+                break;
+            inComment = false;
+            ++p;
+            continue;
+        }
+
+        switch (charClass[(unsigned char)*p])
+        {
+        case CC_SLASH:
+            if (p + 1 < end && p[1] == '*')
+            {
+                inComment = true;
+                ++p;
+                continue;
+            }
+            flushToken();
+            counts.operators++;
+            ++p;
+            break;
+        case CC_OPERATOR:
+            flushToken();
+            counts.operators++;
+            ++p;
+            break;
+        case CC_DQUOTE:
+        {
+            counts.constants++;
+            const char *q = findEither(p + 1, end, '"', '\n');
+            p = (q < end && *q == '"') ? q + 1 : p + 1;
+            break;
+        }
+        case CC_SQUOTE:
+            counts.constants++;
+            ++p;
+            break;
+        case CC_BREAK:
+            flushToken();
+            ++p;
+            if (p < end && isSpaceByte((unsigned char)*p))
+                p = skipSpaces(p, end);
+            break;
+        default:
+            if (!tokBegin)
+            {
+                tokBegin = p;
+            }
+            else if (tokEnd != p)
+            {
+                spill.append(tokBegin, tokEnd);
+                tokBegin = p;
+            }
+            tokEnd = ++p;
+            break;
+        }
+    }
+    flushToken();
+}
+
+TokenCounts &operator+=(TokenCounts &a, const TokenCounts &b)
+{
+    a.keywords += b.keywords;
+    a.identifiers += b.identifiers;
+    a.operators += b.operators;
+    a.constants += b.constants;
+    return a;
+}
+
+// Cut [data, data + size) into about `pieces` chunks, each ending just after
+// a newline. scanBuffer treats a newline as the end of a line, so no token,
+// string literal or "/*" lookahead crosses a cut; only an open block comment
+// carries over from one chunk to the next.
+vector<pair<const char *, const char *>> splitAtNewlines(const char *data, size_t size, size_t pieces)
+{
+    const size_t minChunk = 1 << 20;
+    size_t target = max(minChunk, size / max<size_t>(pieces, 1));
+    vector<pair<const char *, const char *>> chunks;
+    const char *p = data, *end = data + size;
+    while (p < end)
+    {
+        const char *cut = end;
+        if ((size_t)(end - p) > target)
+        {
+            const char *nl = static_cast<const char *>(memchr(p + target, '\n', end - (p + target)));
+            if (nl)
+                cut = nl + 1;
+        }
+        chunks.push_back({p, cut});
+        p = cut;
+    }
+    return chunks;
+}
+
+struct ChunkResult
+{
+    TokenCounts counts;
+    bool endsInComment = false;
+};
+
+// Lex the chunks on `threads` workers that pull the next chunk index from a
+// shared counter. Every chunk is lexed as if no comment were open at its
+// start; the serial merge then rescans the few chunks that really begin
+// inside a block comment, so the totals equal a single scanBuffer pass.
+TokenCounts scanParallel(const char *data, size_t size, unsigned threads)
+{
+    auto chunks = splitAtNewlines(data, size, (size_t)threads * 4);
+    vector<ChunkResult> results(chunks.size());
+    atomic<size_t> nextChunk{0};
+
+    auto worker = [&]()
+    {
+        for (size_t i; (i = nextChunk.fetch_add(1)) < chunks.size();)
+            scanBuffer(chunks[i].first, chunks[i].second, results[i].counts, results[i].endsInComment);
+    };
+    vector<thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &th : pool)
+        th.join();
+
+    TokenCounts total;
+    bool inComment = false;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        if (inComment)
+        {
+            results[i] = ChunkResult();
+            results[i].endsInComment = true;
+            scanBuffer(chunks[i].first, chunks[i].second, results[i].counts, results[i].endsInComment);
+        }
+        total += results[i].counts;
+        inComment = results[i].endsInComment;
+    }
+    return total;
+}
+
+// Read-only memory mapping of a whole file
+struct MappedFile
+{
+    const char *data = nullptr;
+    size_t size = 0;
+    bool ok = false;
+
+    explicit MappedFile(const string &filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+        {
+            size = (size_t)st.st_size;
+            if (size == 0)
+            {
+                ok = true;
+            }
+            else
+            {
+                void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (addr != MAP_FAILED)
+                {
+                    madvise(addr, size, MADV_SEQUENTIAL);
+                    data = static_cast<const char *>(addr);
+                    ok = true;
+                }
+            }
+        }
+        close(fd);
+    }
 
-    file.close();
+    ~MappedFile()
+    {
+        if (data)
+            munmap(const_cast<char *>(data), size);
+    }
 
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+};
+
+void printReport(const TokenCounts &counts)
+{
     cout << "\nLexical Analysis Report:\n";
-    cout << "Keywords    : " << keywordCount << endl;
-    cout << "Identifiers : " << identifierCount << endl;
-    cout << "Operators   : " << operatorCount << endl;
-    cout << "Constants   : " << constantCount << endl;
+    cout << "Keywords    : " << counts.keywords << endl;
+    cout << "Identifiers : " << counts.identifiers << endl;
+    cout << "Operators   : " << counts.operators << endl;
+    cout << "Constants   : " << counts.constants << endl;
     cout << endl;
 }
 
-int main()
+void analyzeFile(const string &filename, unsigned jobs = 1)
+{
+    MappedFile file(filename);
+    if (!file.ok)
+    {
+        cerr << "Error: Could not open file '" << filename << "' for analysis." << endl;
+        return;
+    }
+
+    cout << "Analyzing file: " << filename << "\n";
+
+    TokenCounts counts;
+    if (jobs > 1)
+    {
+        counts = scanParallel(file.data, file.size, jobs);
+    }
+    else
+    {
+        bool inComment = false;
+        scanBuffer(file.data, file.data + file.size, counts, inComment);
+    }
+    printReport(counts);
+}
+
+// Per-worker deques of file indices. A worker pops from the back of its own
+// deque and, once that is empty, steals from the front of the others. Each
+// deque has its own lock, so the only contention is an occasional steal.
+class WorkStealingQueues
+{
+    struct Lane
+    {
+        mutex lock;
+        deque<size_t> items;
+    };
+    vector<unique_ptr<Lane>> lanes;
+
+public:
+    WorkStealingQueues(size_t workers, size_t itemCount)
+    {
+        for (size_t w = 0; w < workers; ++w)
+            lanes.push_back(make_unique<Lane>());
+        // Deal contiguous blocks so neighbouring files start on the same worker
+        for (size_t i = 0; i < itemCount; ++i)
+            lanes[i * workers / itemCount]->items.push_back(i);
+    }
+
+    bool next(size_t self, size_t &item)
+    {
+        {
+            Lane &own = *lanes[self];
+            lock_guard<mutex> guard(own.lock);
+            if (!own.items.empty())
+            {
+                item = own.items.back();
+                own.items.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < lanes.size(); ++k)
+        {
+            Lane &victim = *lanes[(self + k) % lanes.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.items.empty())
+            {
+                item = victim.items.front();
+                victim.items.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+struct FileReport
+{
+    string path;
+    TokenCounts counts;
+    size_t bytes = 0;
+    bool ok = false;
+};
+
+bool isSourceFile(const filesystem::path &path)
+{
+    static const unordered_set<string> extensions = {
+        ".c", ".cc", ".cpp", ".cxx", ".c++", ".h", ".hh", ".hpp", ".hxx", ".inl"};
+    return extensions.count(path.extension().string()) > 0;
+}
+
+// A directory is walked recursively for source files; any other path is
+// read as a list of file names, one per line
+vector<string> collectFiles(const string &source)
+{
+    vector<string> files;
+    error_code ec;
+    if (filesystem::is_directory(source, ec))
+    {
+        auto options = filesystem::directory_options::skip_permission_denied;
+        for (auto it = filesystem::recursive_directory_iterator(source, options, ec);
+             it != filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (ec)
+                break;
+            if (it->is_regular_file(ec) && isSourceFile(it->path()))
+                files.push_back(it->path().string());
+        }
+        sort(files.begin(), files.end());
+        return files;
+    }
+
+    ifstream list(source);
+    if (!list.is_open())
+    {
+        cerr << "Error: Could not open file list '" << source << "'." << endl;
+        return files;
+    }
+    string line;
+    while (getline(list, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty())
+            files.push_back(line);
+    }
+    return files;
+}
+
+// Analyze every file named by source on a work-stealing pool. Each file's
+// counts go to its own slot and each worker keeps private totals, so nothing
+// is shared while the workers run.
+void analyzeBatch(const string &source, unsigned threads)
 {
-    const string filename = "./test_program.cpp";
+    using clock = chrono::steady_clock;
+
+    vector<string> files = collectFiles(source);
+    if (files.empty())
+    {
+        cerr << "Error: No source files found in '" << source << "'." << endl;
+        return;
+    }
+    threads = max(1u, min<unsigned>(threads, files.size()));
+
+    vector<FileReport> reports(files.size());
+    vector<TokenCounts> workerTotals(threads);
+    vector<size_t> workerBytes(threads, 0);
+    WorkStealingQueues queues(threads, files.size());
+
+    auto worker = [&](size_t self)
+    {
+        size_t i;
+        while (queues.next(self, i))
+        {
+            FileReport &report = reports[i];
+            report.path = files[i];
+            MappedFile file(files[i]);
+            if (!file.ok)
+                continue;
+            bool inComment = false;
+            scanBuffer(file.data, file.data + file.size, report.counts, inComment);
+            report.bytes = file.size;
+            report.ok = true;
+            workerTotals[self] += report.counts;
+            workerBytes[self] += file.size;
+        }
+    };
+
+    auto t0 = clock::now();
+    vector<thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+        pool.emplace_back(worker, t);
+    worker(0);
+    for (auto &th : pool)
+        th.join();
+    double secs = chrono::duration<double>(clock::now() - t0).count();
+
+    TokenCounts total;
+    size_t bytes = 0;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        total += workerTotals[t];
+        bytes += workerBytes[t];
+    }
+
+    cout << left << setw(12) << "Keywords" << setw(12) << "Identifiers" << setw(12) << "Operators"
+         << setw(12) << "Constants" << "File\n";
+    size_t failed = 0;
+    for (const FileReport &report : reports)
+    {
+        if (!report.ok)
+        {
+            cerr << "Error: Could not open file '" << report.path << "' for analysis." << endl;
+            failed++;
+            continue;
+        }
+        cout << setw(12) << report.counts.keywords << setw(12) << report.counts.identifiers
+             << setw(12) << report.counts.operators << setw(12) << report.counts.constants
+             << report.path << "\n";
+    }
+
+    cout << "\nAnalyzed " << files.size() - failed << " files (" << bytes / (1024.0 * 1024.0) << " MB) on "
+         << threads << " threads in " << secs * 1000 << " ms: "
+         << (files.size() - failed) / secs << " files/s, " << bytes / (1024.0 * 1024.0) / secs << " MB/s\n";
+    printReport(total);
+}
+
+// Time the getline loop against the mapped scanner on the same file
+void benchmarkFile(const string &filename)
+{
+    using clock = chrono::steady_clock;
+
+    ifstream stream(filename);
+    MappedFile mapped(filename);
+    if (!stream.is_open() || !mapped.ok)
+    {
+        cerr << "Error: Could not open file '" << filename << "' for benchmarking." << endl;
+        return;
+    }
+
+    double megabytes = mapped.size / (1024.0 * 1024.0);
+    cout << "Benchmarking on " << filename << " (" << megabytes << " MB)\n\n";
+
+    auto t0 = clock::now();
+    TokenCounts lineCounts = countTokensGetline(stream);
+    auto t1 = clock::now();
+    TokenCounts mappedCounts;
+    bool inComment = false;
+    scanBuffer(mapped.data, mapped.data + mapped.size, mappedCounts, inComment);
+    auto t2 = clock::now();
+
+    double lineSecs = chrono::duration<double>(t1 - t0).count();
+    double mappedSecs = chrono::duration<double>(t2 - t1).count();
+    cout << "getline loop   : " << lineSecs * 1000 << " ms, " << megabytes / lineSecs << " MB/s\n";
+    cout << "mapped scanner : " << mappedSecs * 1000 << " ms, " << megabytes / mappedSecs << " MB/s\n";
+    cout << "Reports " << (lineCounts == mappedCounts ? "match" : "DIFFER") << "\n";
+    printReport(mappedCounts);
+}
+
+// Compare keyword lookup strategies on the words of a file: a heap string
+// probed in an unordered_set (the previous isKeyword), a linear strcmp scan
+// (as in Lab2) and the perfect hash.
+void benchmarkKeywords(const string &filename)
+{
+    using clock = chrono::steady_clock;
+
+    MappedFile file(filename);
+    if (!file.ok)
+    {
+        cerr << "Error: Could not open file '" << filename << "' for benchmarking." << endl;
+        return;
+    }
+
+    vector<string_view> words;
+    const char *p = file.data, *stop = file.data + file.size;
+    while (p < stop)
+    {
+        while (p < stop && !(isalnum((unsigned char)*p) || *p == '_'))
+            ++p;
+        const char *start = p;
+        while (p < stop && (isalnum((unsigned char)*p) || *p == '_'))
+            ++p;
+        if (p > start)
+            words.push_back(string_view(start, p - start));
+    }
+    if (words.empty())
+    {
+        cerr << "Error: No words to look up in '" << filename << "'." << endl;
+        return;
+    }
+
+    unordered_set<string> keywordSet;
+    for (string_view k : keywordNames)
+        keywordSet.insert(string(k));
+    auto viaSet = [&](string_view w)
+    { return keywordSet.count(string(w)) > 0; };
+    auto viaStrcmp = [&](string_view w)
+    {
+        char buffer[256];
+        if (w.size() >= sizeof(buffer))
+            return false;
+        memcpy(buffer, w.data(), w.size());
+        buffer[w.size()] = '\0';
+        for (string_view k : keywordNames)
+            if (strcmp(buffer, k.data()) == 0)
+                return true;
+        return false;
+    };
+    auto viaHash = [](string_view w)
+    { return classifyKeyword(w) != Keyword::None; };
+
+    const int passes = max<int>(1, 2000000 / (int)words.size());
+    auto run = [&](const char *label, auto lookup)
+    {
+        long long hits = 0;
+        auto t0 = clock::now();
+        for (int pass = 0; pass < passes; ++pass)
+            for (string_view w : words)
+                hits += lookup(w);
+        double secs = chrono::duration<double>(clock::now() - t0).count();
+        cout << label << secs * 1e9 / ((double)passes * words.size()) << " ns/lookup ("
+             << hits / passes << " keywords)\n";
+    };
+
+    cout << "Keyword lookup over " << words.size() << " words, " << passes << " passes\n\n";
+    run("unordered_set<string> : ", viaSet);
+    run("linear strcmp         : ", viaStrcmp);
+    run("perfect hash          : ", viaHash);
+}
+
+// Cross-check the vector kernels against the scalar ones on random buffers,
+// then time both on long runs with no match
+void benchmarkKernels()
+{
+    using clock = chrono::steady_clock;
+
+    mt19937 rng(12345);
+    const string alphabet = " \t\n\r*/\"ab";
+    string buffer;
+    int mismatches = 0;
+    const int cases = 20000;
+    for (int c = 0; c < cases; ++c)
+    {
+        buffer.resize(rng() % 200);
+        int spread = 1 + rng() % alphabet.size();
+        for (char &ch : buffer)
+            ch = alphabet[rng() % spread];
+        const char *end = buffer.data() + buffer.size();
+        const char *p = buffer.data() + (buffer.empty() ? 0 : rng() % buffer.size());
+        mismatches += skipSpaces(p, end) != skipSpacesScalar(p, end);
+        mismatches += findEither(p, end, '"', '\n') != findEitherScalar(p, end, '"', '\n');
+        mismatches += findCommentClose(p, end) != findCommentCloseScalar(p, end);
+    }
+    cout << "Fuzz check: " << cases << " buffers, " << mismatches << " mismatches\n\n";
+
+    const size_t size = 64 << 20;
+    string spaces(size, ' ');
+    string text(size, 'a');
+    string stars(size, '*');
+    for (size_t i = 0; i < size; i += 3)
+        spaces[i] = '\t';
+
+    auto run = [&](const char *label, const string &input, auto kernel)
+    {
+        auto t0 = clock::now();
+        const char *hit = kernel(input.data(), input.data() + input.size());
+        double secs = chrono::duration<double>(clock::now() - t0).count();
+        cout << label << size / secs / 1e9 << " GB/s" << (hit == input.data() + input.size() ? "" : " (early hit)") << "\n";
+    };
+
+    run("skipSpaces scalar       : ", spaces, skipSpacesScalar);
+    run("skipSpaces vector       : ", spaces, skipSpaces);
+    run("findEither scalar       : ", text, [](const char *p, const char *e)
+        { return findEitherScalar(p, e, '"', '\n'); });
+    run("findEither vector       : ", text, [](const char *p, const char *e)
+        { return findEither(p, e, '"', '\n'); });
+    run("findCommentClose scalar : ", stars, findCommentCloseScalar);
+    run("findCommentClose vector : ", stars, findCommentClose);
+}
+
+// Scaling of scanParallel from one worker up to maxThreads
+void benchmarkParallel(const string &filename, unsigned maxThreads)
+{
+    using clock = chrono::steady_clock;
+
+    MappedFile file(filename);
+    if (!file.ok)
+    {
+        cerr << "Error: Could not open file '" << filename << "' for benchmarking." << endl;
+        return;
+    }
+
+    double megabytes = file.size / (1024.0 * 1024.0);
+    cout << "Parallel scan of " << filename << " (" << megabytes << " MB), "
+         << thread::hardware_concurrency() << " hardware threads\n\n";
+
+    TokenCounts serial;
+    bool inComment = false;
+    auto t0 = clock::now();
+    scanBuffer(file.data, file.data + file.size, serial, inComment);
+    double serialSecs = chrono::duration<double>(clock::now() - t0).count();
+    cout << "serial     : " << megabytes / serialSecs << " MB/s\n";
+
+    for (unsigned threads = 1; threads <= maxThreads; ++threads)
+    {
+        auto t1 = clock::now();
+        TokenCounts counts = scanParallel(file.data, file.size, threads);
+        double secs = chrono::duration<double>(clock::now() - t1).count();
+        cout << "threads " << threads << (threads < 10 ? "  : " : " : ") << megabytes / secs << " MB/s, speedup "
+             << serialSecs / secs << (counts == serial ? "" : "  (counts DIFFER from serial)") << "\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && string(argv[1]) == "--bench")
+    {
+        benchmarkFile(argv[2]);
+        return 0;
+    }
+    if (argc == 2 && string(argv[1]) == "--bench-simd")
+    {
+        benchmarkKernels();
+        return 0;
+    }
+    if (argc == 3 && string(argv[1]) == "--bench-keywords")
+    {
+        benchmarkKeywords(argv[2]);
+        return 0;
+    }
+
+    if ((argc == 3 || argc == 4) && string(argv[1]) == "--bench-parallel")
+    {
+        unsigned maxThreads = argc == 4 ? stoi(argv[3]) : max(1u, thread::hardware_concurrency());
+        benchmarkParallel(argv[2], maxThreads);
+        return 0;
+    }
+    if ((argc == 3 || argc == 4) && (string(argv[1]) == "--dir" || string(argv[1]) == "--list"))
+    {
+        unsigned threads = argc == 4 ? stoi(argv[3]) : max(1u, thread::hardware_concurrency());
+        analyzeBatch(argv[2], threads);
+        return 0;
+    }
+    if (argc == 4 && string(argv[1]) == "--jobs")
+    {
+        analyzeFile(argv[3], max(1, stoi(argv[2])));
+        return 0;
+    }
+
+    const string filename = argc > 1 ? argv[1] : "./test_program.cpp";
     analyzeFile(filename);
     return 0;
 }
@@ -1,69 +1,341 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
 
-#define MAX_LEN 200
+#define BUFFER_HALF 4096
 #define LEFT_SPACE 20
 
-const char *keywords[] = {"int", "float", "if", "else", "while", "return", "for", "break", "continue", "char", "double", "void"};
+typedef enum
+{
+    KW_NONE,
+    KW_INT,
+    KW_FLOAT,
+    KW_IF,
+    KW_ELSE,
+    KW_WHILE,
+    KW_RETURN,
+    KW_FOR,
+    KW_BREAK,
+    KW_CONTINUE,
+    KW_CHAR,
+    KW_DOUBLE,
+    KW_VOID
+} Keyword;
 
-int isKeyword(char *word)
+// Keyword lookup by length, then first character: at most one memcmp per word
+Keyword classifyKeyword(const char *word, size_t len)
 {
-    for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
+    switch (len)
     {
-        if (strcmp(word, keywords[i]) == 0)
-            return 1;
+    case 2:
+        if (word[0] == 'i' && word[1] == 'f')
+            return KW_IF;
+        break;
+    case 3:
+        if (word[0] == 'i' && memcmp(word, "int", 3) == 0)
+            return KW_INT;
+        if (word[0] == 'f' && memcmp(word, "for", 3) == 0)
+            return KW_FOR;
+        break;
+    case 4:
+        if (word[0] == 'e' && memcmp(word, "else", 4) == 0)
+            return KW_ELSE;
+        if (word[0] == 'c' && memcmp(word, "char", 4) == 0)
+            return KW_CHAR;
+        if (word[0] == 'v' && memcmp(word, "void", 4) == 0)
+            return KW_VOID;
+        break;
+    case 5:
+        if (word[0] == 'f' && memcmp(word, "float", 5) == 0)
+            return KW_FLOAT;
+        if (word[0] == 'w' && memcmp(word, "while", 5) == 0)
+            return KW_WHILE;
+        if (word[0] == 'b' && memcmp(word, "break", 5) == 0)
+            return KW_BREAK;
+        break;
+    case 6:
+        if (word[0] == 'r' && memcmp(word, "return", 6) == 0)
+            return KW_RETURN;
+        if (word[0] == 'd' && memcmp(word, "double", 6) == 0)
+            return KW_DOUBLE;
+        break;
+    case 8:
+        if (word[0] == 'c' && memcmp(word, "continue", 8) == 0)
+            return KW_CONTINUE;
+        break;
     }
-    return 0;
+    return KW_NONE;
 }
 
 int isSpecialSymbol(char c) { return c == '(' || c == ')' || c == '{' || c == '}' || c == ';' || c == ','; }
 
 int isOperator(char c) { return c == '+' || c == '-' || c == '*' || c == '/' || c == '=' || c == '<' || c == '>' || c == '!'; }
 
-void printToken(char *type, char *value) { printf("%*s : %s\n", LEFT_SPACE, type, value); }
+void printToken(FILE *out, const char *type, const char *value) { fprintf(out, "%*s : %s\n", LEFT_SPACE, type, value); }
 
-void printError(char *message, char *value, int line)
+void printError(FILE *out, const char *message, const char *value, int line)
 {
     // char typeFormatted[100];
     // sprintf(typeFormatted, "\033[1;31mError (line %d):\033[0m Invalid token :", line);
     // printf("\033[1;31mError:\033[0m %s '%s'\n", message, value);
 
-    printf("\033[1;31mError in (line %d):\033[0m\n", line);
-    printf("\033[1;31m%*s :\033[0m %s\n", LEFT_SPACE, message, value);
+    fprintf(out, "\033[1;31mError in (line %d):\033[0m\n", line);
+    fprintf(out, "\033[1;31m%*s :\033[0m %s\n", LEFT_SPACE, message, value);
 }
 
-int main()
+// Two-buffer input scheme: the file is read in halves of BUFFER_HALF bytes,
+// each followed by a '\0' sentinel, so nextChar only tests for the sentinel
+// instead of calling into stdio for every character. A sentinel at the end
+// of a half reloads the other half; one at `limit` is the end of input; any
+// other '\0' is a NUL byte of the source.
+typedef struct
 {
-    // printf("\033[1;31mError:\033[0m Invalid token '123_new'\n");
+    FILE *file;
+    char data[2 * (BUFFER_HALF + 1)];
+    char *forward;
+    char *limit;          // sentinel that marks end of input, NULL until it is read
+    uint32_t halfBase[2]; // input offset of the first byte of each half
+    uint32_t filled;      // bytes read from the file so far
+} InputBuffer;
 
-    FILE *file = fopen("test_code.c", "r");
-    if (!file)
+static void fillHalf(InputBuffer *in, char *half)
+{
+    in->halfBase[half != in->data] = in->filled;
+    size_t n = fread(half, 1, BUFFER_HALF, in->file);
+    in->filled += n;
+    half[n] = '\0';
+    if (n < BUFFER_HALF)
+        in->limit = half + n;
+}
+
+void initInput(InputBuffer *in, FILE *file)
+{
+    in->file = file;
+    in->limit = NULL;
+    in->filled = 0;
+    in->forward = in->data;
+    fillHalf(in, in->data);
+}
+
+int nextChar(InputBuffer *in)
+{
+    char *secondHalf = in->data + BUFFER_HALF + 1;
+    for (;;)
     {
-        printf("Error opening file!\n");
-        return 1;
+        char c = *in->forward++;
+        if (c != '\0')
+            return (unsigned char)c;
+
+        char *at = in->forward - 1;
+        if (at == in->limit)
+        {
+            in->forward = at; // stay on the sentinel, EOF again next time
+            return EOF;
+        }
+        if (at == secondHalf - 1)
+        {
+            fillHalf(in, secondHalf);
+            in->forward = secondHalf;
+        }
+        else if (at == in->data + 2 * BUFFER_HALF + 1)
+        {
+            fillHalf(in, in->data);
+            in->forward = in->data;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+}
+
+// Push back the character just read, like ungetc. The previous half is
+// never reloaded before the next half is consumed, so one step back is
+// always still in memory.
+void retract(InputBuffer *in, int c)
+{
+    if (c == EOF)
+        return;
+    if (in->forward == in->data)
+        in->forward = in->data + 2 * BUFFER_HALF;
+    else if (in->forward == in->data + BUFFER_HALF + 1)
+        in->forward = in->data + BUFFER_HALF - 1;
+    else
+        in->forward--;
+}
+
+// Input offset of the next character nextChar will return
+uint32_t inputOffset(const InputBuffer *in)
+{
+    if (in->forward <= in->data + BUFFER_HALF)
+        return in->halfBase[0] + (uint32_t)(in->forward - in->data);
+    return in->halfBase[1] + (uint32_t)(in->forward - (in->data + BUFFER_HALF + 1));
+}
+
+// Growable, NUL-terminated lexeme text
+typedef struct
+{
+    char *text;
+    size_t len;
+    size_t cap;
+} TokenBuffer;
+
+void tokenPut(TokenBuffer *t, char c)
+{
+    if (t->len + 2 > t->cap)
+    {
+        t->cap = t->cap ? 2 * t->cap : 256;
+        t->text = realloc(t->text, t->cap);
+        if (!t->text)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
     }
+    t->text[t->len++] = c;
+    t->text[t->len] = '\0';
+}
+
+void tokenSet(TokenBuffer *t, char c)
+{
+    t->len = 0;
+    tokenPut(t, c);
+}
+
+
+typedef enum
+{
+    TOK_PREPROCESSOR,
+    TOK_LINE_COMMENT,
+    TOK_BLOCK_COMMENT,
+    TOK_STRING,
+    TOK_KEYWORD,
+    TOK_IDENTIFIER,
+    TOK_INTEGER,
+    TOK_FLOAT,
+    TOK_OPERATOR,
+    TOK_SPECIAL,
+    TOK_INVALID,
+    TOK_KIND_COUNT
+} TokenKind;
+
+const char *tokenKindNames[TOK_KIND_COUNT] = {
+    "Preprocessor", "Single-line Comment", "Multi-line Comment", "String Literal", "Keyword",
+    "Identifier", "Integer", "Float", "Operator", "Special Symbol", "Invalid token"};
+
+// One lexed token. The text is not copied: offset and length locate it in
+// the input, so records stay 16 bytes and inputs are limited to 4 GiB.
+typedef struct
+{
+    uint32_t offset;
+    uint32_t length;
+    uint32_t line;
+    uint8_t kind; // TokenKind
+} Token;
+
+typedef struct
+{
+    Token *items;
+    size_t count;
+    size_t cap;
+} TokenList;
+
+typedef struct
+{
+    const TokenList *list;
+    size_t next;
+} TokenIter;
+
+TokenIter tokenIter(const TokenList *list)
+{
+    TokenIter it = {list, 0};
+    return it;
+}
+
+// Next token, or NULL after the last one
+const Token *nextToken(TokenIter *it)
+{
+    return it->next < it->list->count ? &it->list->items[it->next++] : NULL;
+}
+
+void freeTokens(TokenList *list)
+{
+    free(list->items);
+    list->items = NULL;
+    list->count = list->cap = 0;
+}
 
-    char ch, buffer[MAX_LEN];
-    int i = 0;
+// Called for every token as it is lexed, with the lexeme as the lexer
+// prints it (multi-line comments are re-indented, strings get a closing quote)
+typedef void (*TokenSink)(const Token *tok, const char *text, void *ctx);
+
+// Sink that prints tokens in the original report format to the FILE * in ctx
+void printTokenSink(const Token *tok, const char *text, void *ctx)
+{
+    FILE *out = ctx;
+    if (tok->kind == TOK_INVALID)
+        printError(out, tokenKindNames[TOK_INVALID], text, tok->line);
+    else
+        printToken(out, tokenKindNames[tok->kind], text);
+}
+
+typedef struct
+{
+    TokenList *out; // may be NULL
+    TokenSink sink; // may be NULL
+    void *ctx;
+} Emitter;
+
+void emit(Emitter *em, TokenKind kind, uint32_t start, uint32_t end, int line, const char *text)
+{
+    Token tok = {start, end - start, (uint32_t)line, (uint8_t)kind};
+    if (em->out)
+    {
+        TokenList *list = em->out;
+        if (list->count == list->cap)
+        {
+            list->cap = list->cap ? 2 * list->cap : 1024;
+            list->items = realloc(list->items, list->cap * sizeof(Token));
+            if (!list->items)
+            {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+        }
+        list->items[list->count++] = tok;
+    }
+    if (em->sink)
+        em->sink(&tok, text, em->ctx);
+}
+
+// Lex the whole input. Tokens are appended to out and passed to sink; either
+// may be NULL.
+void lexInput(InputBuffer *in, TokenList *out, TokenSink sink, void *ctx)
+{
+    Emitter em = {out, sink, ctx};
+    TokenBuffer tok = {NULL, 0, 0};
+    int ch;
     int line = 1;
 
-    while ((ch = fgetc(file)) != EOF)
+    while ((ch = nextChar(in)) != EOF)
     {
         if (isspace(ch))
             continue;
 
+        uint32_t start = inputOffset(in) - 1;
+
         // Handle preprocessor line
         if (ch == '#')
         {
-            i = 0;
-            buffer[i++] = ch;
-            while ((ch = fgetc(file)) != EOF && ch != '\n')
+            tokenSet(&tok, ch);
+            while ((ch = nextChar(in)) != EOF && ch != '\n')
             {
-                buffer[i++] = ch;
+                tokenPut(&tok, ch);
             }
-            buffer[i] = '\0';
-            printToken("Preprocessor", buffer);
+            emit(&em, TOK_PREPROCESSOR, start, inputOffset(in) - (ch == '\n'), line, tok.text);
             line++;
             continue;
         }
@@ -71,74 +343,58 @@ int main()
         // Handle comments
         if (ch == '/')
         {
-            char next = fgetc(file);
+            int next = nextChar(in);
             if (next == '/')
             {
                 // Single-line comment
-                i = 0;
-                buffer[i++] = '/';
-                buffer[i++] = '/';
-                while ((ch = fgetc(file)) != EOF && ch != '\n')
+                tokenSet(&tok, '/');
+                tokenPut(&tok, '/');
+                while ((ch = nextChar(in)) != EOF && ch != '\n')
                 {
-                    buffer[i++] = ch;
+                    tokenPut(&tok, ch);
                 }
-                buffer[i] = '\0';
-                printToken("Single-line Comment", buffer);
+                emit(&em, TOK_LINE_COMMENT, start, inputOffset(in) - (ch == '\n'), line, tok.text);
                 line++;
                 continue;
             }
             else if (next == '*')
             {
                 // Multi-line comment
-                i = 0;
-                buffer[i++] = '/';
-                buffer[i++] = '*';
+                tokenSet(&tok, '/');
+                tokenPut(&tok, '*');
                 int prev = 0;
 
-                while ((ch = fgetc(file)) != EOF)
+                while ((ch = nextChar(in)) != EOF)
                 {
                     if (ch == '\n')
                     {
                         line++;
-                        // buffer[i++] = '\\';
-                        // buffer[i++] = 'n';
-                        buffer[i++] = '\n';
+                        tokenPut(&tok, '\n');
                         for (int j = 0; j < LEFT_SPACE + 1; j++)
                         {
-                            buffer[i++] = ' ';
+                            tokenPut(&tok, ' ');
                         }
-                        buffer[i++] = ':';
+                        tokenPut(&tok, ':');
                     }
                     else
                     {
-                        buffer[i++] = ch;
+                        tokenPut(&tok, ch);
                     }
 
                     if (prev == '*' && ch == '/')
                         break;
 
                     prev = ch;
-
-                    // Prevent overflow
-                    if (i >= MAX_LEN - 2)
-                    {
-                        buffer[i++] = '.';
-                        buffer[i++] = '.';
-                        buffer[i++] = '.';
-                        break;
-                    }
                 }
-                buffer[i] = '\0';
-                printToken("Multi-line Comment", buffer);
+                emit(&em, TOK_BLOCK_COMMENT, start, inputOffset(in), line, tok.text);
                 continue;
             }
             else
             {
                 // It's just an operator /
-                ungetc(next, file);
-                buffer[0] = ch;
-                buffer[1] = '\0';
-                printToken("Operator", buffer);
+                retract(in, next);
+                tokenSet(&tok, ch);
+                emit(&em, TOK_OPERATOR, start, inputOffset(in), line, tok.text);
                 continue;
             }
         }
@@ -146,32 +402,28 @@ int main()
         // Handle string literals
         if (ch == '"')
         {
-            i = 0;
-            buffer[i++] = ch;
-            while ((ch = fgetc(file)) != EOF && ch != '"')
+            tokenSet(&tok, ch);
+            while ((ch = nextChar(in)) != EOF && ch != '"')
             {
-                buffer[i++] = ch;
+                tokenPut(&tok, ch);
                 if (ch == '\n')
                     line++;
             }
-            buffer[i++] = '"'; // add closing quote
-            buffer[i] = '\0';
-            printToken("String Literal", buffer);
+            tokenPut(&tok, '"'); // add closing quote
+            emit(&em, TOK_STRING, start, inputOffset(in), line, tok.text);
             continue;
         }
 
         // Unified block for identifiers, keywords, and numbers
         if (isalpha(ch) || ch == '_' || isdigit(ch))
         {
-            i = 0;
-            buffer[i++] = ch;
+            tokenSet(&tok, ch);
 
             int isFirstDigit = isdigit(ch);
             int hasDot = 0;
-            int hasAlpha = isalpha(ch);
             int isValid = 1;
 
-            while ((ch = fgetc(file)) != EOF && (isalnum(ch) || ch == '_' || ch == '.'))
+            while ((ch = nextChar(in)) != EOF && (isalnum(ch) || ch == '_' || ch == '.'))
             {
                 if (ch == '.')
                 {
@@ -183,38 +435,36 @@ int main()
                 }
                 else if (isalpha(ch) || ch == '_')
                 {
-                    hasAlpha = 1;
                     if (isFirstDigit) // starts as number but has alpha → invalid
                         isValid = 0;
                 }
-                buffer[i++] = ch;
+                tokenPut(&tok, ch);
             }
 
-            buffer[i] = '\0';
-            ungetc(ch, file);
+            retract(in, ch);
 
             if (!isValid)
             {
-                printError("Invalid token", buffer, line);
+                emit(&em, TOK_INVALID, start, inputOffset(in), line, tok.text);
             }
-            else if (isKeyword(buffer))
+            else if (classifyKeyword(tok.text, tok.len) != KW_NONE)
             {
-                printToken("Keyword", buffer);
+                emit(&em, TOK_KEYWORD, start, inputOffset(in), line, tok.text);
             }
-            else if (isdigit(buffer[0]))
+            else if (isdigit((unsigned char)tok.text[0]))
             {
                 if (hasDot)
-                    printToken("Float", buffer);
+                    emit(&em, TOK_FLOAT, start, inputOffset(in), line, tok.text);
                 else
-                    printToken("Integer", buffer);
+                    emit(&em, TOK_INTEGER, start, inputOffset(in), line, tok.text);
             }
-            else if (isalpha(buffer[0]) || buffer[0] == '_')
+            else if (isalpha((unsigned char)tok.text[0]) || tok.text[0] == '_')
             {
-                printToken("Identifier", buffer);
+                emit(&em, TOK_IDENTIFIER, start, inputOffset(in), line, tok.text);
             }
             else
             {
-                printError("Invalid token", buffer, line);
+                emit(&em, TOK_INVALID, start, inputOffset(in), line, tok.text);
             }
 
             continue;
@@ -223,31 +473,27 @@ int main()
         // Two-character operators
         else if (isOperator(ch))
         {
-            char next = fgetc(file);
-            buffer[0] = ch;
+            int next = nextChar(in);
+            tokenSet(&tok, ch);
             if (next == '=' || (ch == next && (ch == '+' || ch == '-' || ch == '&' || ch == '|')))
             {
-                buffer[1] = next;
-                buffer[2] = '\0';
+                tokenPut(&tok, next);
             }
             else
             {
-                buffer[1] = '\0';
-                ungetc(next, file);
+                retract(in, next);
             }
-            printToken("Operator", buffer);
+            emit(&em, TOK_OPERATOR, start, inputOffset(in), line, tok.text);
         }
 
         // Special symbols
         else if (isSpecialSymbol(ch))
         {
-            // if (ch == '{' || ch == '}' || ch == ')' || ch == ';') line++;
             if (ch == '{' || ch == '}' || ch == ')' || ch == ';')
                 line++;
 
-            buffer[0] = ch;
-            buffer[1] = '\0';
-            printToken("Special Symbol", buffer);
+            tokenSet(&tok, ch);
+            emit(&em, TOK_SPECIAL, start, inputOffset(in), line, tok.text);
         }
 
         // Ignore newline
@@ -260,13 +506,118 @@ int main()
         // Unknown character
         else
         {
-            buffer[0] = ch;
-            buffer[1] = '\0';
+            tokenSet(&tok, ch);
             line++;
-            printError("Invalid token", buffer, line);
+            emit(&em, TOK_INVALID, start, inputOffset(in), line, tok.text);
         }
     }
 
+    free(tok.text);
+}
+
+double secondsSince(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Read a whole file through fgetc and through nextChar, counting lines, and
+// report the throughput of each reader. Then time lexInput into a token list
+// with no sink and with the printing sink writing to /dev/null.
+int benchmarkLexer(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (!file)
+    {
+        printf("Error opening file!\n");
+        return 1;
+    }
+
+    struct timespec start;
+    long bytes = 0, lines = 0;
+    int ch;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((ch = fgetc(file)) != EOF)
+    {
+        bytes++;
+        lines += (ch == '\n');
+    }
+    double stdioSecs = secondsSince(&start);
+
+    rewind(file);
+    static InputBuffer in;
+    long bufferedBytes = 0, bufferedLines = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    initInput(&in, file);
+    while ((ch = nextChar(&in)) != EOF)
+    {
+        bufferedBytes++;
+        bufferedLines += (ch == '\n');
+    }
+    double bufferedSecs = secondsSince(&start);
+
+    double megabytes = bytes / (1024.0 * 1024.0);
+    printf("%s: %.2f MB, %ld lines\n\n", filename, megabytes, lines);
+    printf("fgetc            : %8.2f ms, %8.2f MB/s\n", stdioSecs * 1000, megabytes / stdioSecs);
+    printf("two-buffer       : %8.2f ms, %8.2f MB/s\n", bufferedSecs * 1000, megabytes / bufferedSecs);
+    if (bufferedBytes != bytes || bufferedLines != lines)
+        printf("Readers DIFFER: %ld bytes, %ld lines through nextChar\n", bufferedBytes, bufferedLines);
+
+    TokenList tokens = {NULL, 0, 0};
+    rewind(file);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    initInput(&in, file);
+    lexInput(&in, &tokens, NULL, NULL);
+    double lexSecs = secondsSince(&start);
+
+    FILE *devnull = fopen("/dev/null", "w");
+    TokenList printed = {NULL, 0, 0};
+    rewind(file);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    initInput(&in, file);
+    lexInput(&in, &printed, printTokenSink, devnull);
+    double printSecs = secondsSince(&start);
+    fclose(devnull);
+    fclose(file);
+
+    printf("lex, no sink     : %8.2f ms, %8.2f MB/s, %.2f M tokens/s\n", lexSecs * 1000, megabytes / lexSecs,
+           tokens.count / lexSecs / 1e6);
+    printf("lex, print sink  : %8.2f ms, %8.2f MB/s, %.2f M tokens/s\n", printSecs * 1000, megabytes / printSecs,
+           printed.count / printSecs / 1e6);
+
+    long perKind[TOK_KIND_COUNT] = {0};
+    TokenIter it = tokenIter(&tokens);
+    const Token *tok;
+    while ((tok = nextToken(&it)))
+        perKind[tok->kind]++;
+    printf("\n%zu tokens (%zu bytes of records)\n", tokens.count, tokens.count * sizeof(Token));
+    for (int k = 0; k < TOK_KIND_COUNT; k++)
+        printf("%*s : %ld\n", LEFT_SPACE, tokenKindNames[k], perKind[k]);
+
+    freeTokens(&tokens);
+    freeTokens(&printed);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && strcmp(argv[1], "--bench") == 0)
+        return benchmarkLexer(argv[2]);
+
+    FILE *file = fopen(argc > 1 ? argv[1] : "test_code.c", "r");
+    if (!file)
+    {
+        printf("Error opening file!\n");
+        return 1;
+    }
+
+    static InputBuffer in;
+    TokenList tokens = {NULL, 0, 0};
+    initInput(&in, file);
+    lexInput(&in, &tokens, printTokenSink, stdout);
+    freeTokens(&tokens);
+
     fclose(file);
     return 0;
 }
@@ -1,37 +1,423 @@
 // Implement a lexical analyzer that scans a source program and builds a symbol table for identifiers, numbers, and literals, according to the specified lexical rules.
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <random>
 #include <string>
 #include <vector>
 #include <cctype>
-#include <unordered_set>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
+enum class Keyword : unsigned char {
+    None, Int, Float, Char, Double, Bool, Void, Return,
+    If, Else, While, For, Do, Switch, Case, Break,
+    Continue, Class, Struct, Public, Private, Protected,
+    New, Delete, This, Const, Static, Using, Namespace
+};
+
+// Spellings in Keyword order, without Keyword::None
+constexpr string_view keywordNames[] = {
+    "int", "float", "char", "double", "bool", "void", "return",
+    "if", "else", "while", "for", "do", "switch", "case", "break",
+    "continue", "class", "struct", "public", "private", "protected",
+    "new", "delete", "this", "const", "static", "using", "namespace"
+};
+
+// Compile-time perfect hash over keywordNames: a lookup is one hash, one
+// probe and one compare, with no allocation.
+constexpr size_t KEYWORD_SLOTS = 256;
+constexpr size_t MAX_KEYWORD_LEN = 9;
+
+constexpr uint32_t keywordHash(string_view word, uint32_t seed) {
+    uint32_t h = seed ^ (uint32_t)word.size();
+    for (char c : word) {
+        h = (h ^ (unsigned char)c) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+struct KeywordTable {
+    uint32_t seed;
+    array<unsigned char, KEYWORD_SLOTS> slot; // Keyword value, 0 if empty
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    for (uint32_t seed = 1;; ++seed) {
+        KeywordTable table{seed, {}};
+        bool collision = false;
+        for (size_t i = 0; i < size(keywordNames) && !collision; ++i) {
+            auto& slot = table.slot[keywordHash(keywordNames[i], seed) % KEYWORD_SLOTS];
+            if (slot) {
+                collision = true;
+            } else {
+                slot = (unsigned char)(i + 1);
+            }
+        }
+        if (!collision) {
+            return table;
+        }
+    }
+}
+
+constexpr KeywordTable keywordTable = buildKeywordTable();
+
+constexpr Keyword classifyKeyword(string_view word) {
+    if (word.size() < 2 || word.size() > MAX_KEYWORD_LEN) {
+        return Keyword::None;
+    }
+    unsigned char k = keywordTable.slot[keywordHash(word, keywordTable.seed) % KEYWORD_SLOTS];
+    if (k && keywordNames[k - 1] == word) {
+        return Keyword(k);
+    }
+    return Keyword::None;
+}
+
+static_assert(size(keywordNames) == size_t(Keyword::Namespace), "keywordNames must follow Keyword order");
+
+// Byte-search kernels for the skipping loops in analyze(). Each returns the
+// first position in [p, end) that matches, or end. The SSE2/AVX2 versions
+// test 16 or 32 bytes per step and finish the tail with the scalar version.
+
+inline bool isSpaceByte(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+const char* skipSpacesScalar(const char* p, const char* end) {
+    while (p < end && isSpaceByte((unsigned char)*p)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* findByteScalar(const char* p, const char* end, char c) {
+    while (p < end && *p != c) {
+        ++p;
+    }
+    return p;
+}
+
+// Position of the '*' in the first "*/"
+const char* findCommentCloseScalar(const char* p, const char* end) {
+    while (p + 1 < end && !(p[0] == '*' && p[1] == '/')) {
+        ++p;
+    }
+    return p + 1 < end ? p : end;
+}
+
+size_t countByteScalar(const char* p, const char* end, char c) {
+    size_t n = 0;
+    for (; p < end; ++p) {
+        n += (*p == c);
+    }
+    return n;
+}
+
+#if defined(__SSE2__)
+// 0xFF in every lane holding ' ' or '\t'..'\r'
+inline __m128i spaceLanes(__m128i v) {
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(shifted, _mm_set1_epi8(4)), _mm_set1_epi8(4));
+    return _mm_or_si128(control, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+#endif
+
+#if defined(__AVX2__)
+inline __m256i spaceLanes(__m256i v) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i control = _mm256_cmpeq_epi8(_mm256_max_epu8(shifted, _mm256_set1_epi8(4)), _mm256_set1_epi8(4));
+    return _mm256_or_si256(control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+#endif
+
+const char* skipSpaces(const char* p, const char* end) {
+#if defined(__AVX2__)
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(spaceLanes(v));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t mask = ~(uint32_t)_mm_movemask_epi8(spaceLanes(v)) & 0xFFFF;
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    return skipSpacesScalar(p, end);
+}
+
+const char* findByte(const char* p, const char* end, char c) {
+#if defined(__AVX2__)
+    const __m256i wide = _mm256_set1_epi8(c);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, wide));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i narrow = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, narrow));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    return findByteScalar(p, end, c);
+}
+
+const char* findCommentClose(const char* p, const char* end) {
+    // Compare the block with '*' and the block one byte later with '/'
+#if defined(__AVX2__)
+    const __m256i wideStar = _mm256_set1_epi8('*'), wideSlash = _mm256_set1_epi8('/');
+    for (; end - p > 32; p += 32) {
+        __m256i star = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), wideStar);
+        __m256i slash = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1)), wideSlash);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(star, slash));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i narrowStar = _mm_set1_epi8('*'), narrowSlash = _mm_set1_epi8('/');
+    for (; end - p > 16; p += 16) {
+        __m128i star = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), narrowStar);
+        __m128i slash = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1)), narrowSlash);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(star, slash));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    return findCommentCloseScalar(p, end);
+}
+
+// Newline counting for the spans skipped above
+size_t countByte(const char* p, const char* end, char c) {
+    size_t n = 0;
+#if defined(__AVX2__)
+    const __m256i wide = _mm256_set1_epi8(c);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        n += __builtin_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, wide)));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i narrow = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        n += __builtin_popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, narrow)));
+    }
+#endif
+    return n + countByteScalar(p, end, c);
+}
+
+// Append-only storage for lexeme text. Blocks are never moved or freed while
+// the arena lives, so the string_views it returns stay valid.
+class StringArena {
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    vector<unique_ptr<char[]>> blocks;
+    size_t used = 0;
+    size_t capacity = 0;
+
+public:
+    string_view store(string_view text) {
+        if (text.size() > capacity - used) {
+            capacity = max(BLOCK_SIZE, text.size());
+            blocks.push_back(make_unique<char[]>(capacity));
+            used = 0;
+        }
+        char* dest = blocks.back().get() + used;
+        memcpy(dest, text.data(), text.size());
+        used += text.size();
+        return string_view(dest, text.size());
+    }
+};
+
+uint32_t hashLexeme(string_view text) {
+    uint32_t h = 2166136261u;
+    for (char c : text) {
+        h = (h ^ (unsigned char)c) * 16777619u;
+    }
+    return h;
+}
+
+// Lines on which a symbol is used, stored as zigzag varint deltas from the
+// previous line. analyze() only moves forward, so most deltas fit in one
+// byte and repeated uses on the same line cost a single zero byte.
+class LineList {
+    vector<uint8_t> bytes;
+    int last = 0;
+    size_t count = 0;
+
+    // Add the delta encoded at p to line; returns the next encoding
+    static const uint8_t* decode(const uint8_t* p, int& line) {
+        uint32_t zigzag = 0;
+        int shift = 0;
+        while (*p & 0x80) {
+            zigzag |= uint32_t(*p++ & 0x7F) << shift;
+            shift += 7;
+        }
+        zigzag |= uint32_t(*p++) << shift;
+        line += int32_t(zigzag >> 1) ^ -int32_t(zigzag & 1);
+        return p;
+    }
+
+public:
+    class const_iterator {
+        const uint8_t* pos; // encoding of the current line
+        int previous;       // line before the current one
+
+    public:
+        const_iterator(const uint8_t* p, int prev) : pos(p), previous(prev) {}
+        int operator*() const {
+            int line = previous;
+            decode(pos, line);
+            return line;
+        }
+        const_iterator& operator++() {
+            pos = decode(pos, previous);
+            return *this;
+        }
+        bool operator!=(const const_iterator& other) const { return pos != other.pos; }
+    };
+
+    void push_back(int line) {
+        int32_t delta = line - last;
+        uint32_t zigzag = (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+        while (zigzag >= 0x80) {
+            bytes.push_back(uint8_t(zigzag) | 0x80);
+            zigzag >>= 7;
+        }
+        bytes.push_back(uint8_t(zigzag));
+        last = line;
+        count++;
+    }
+
+    size_t size() const { return count; }
+    size_t memoryBytes() const { return bytes.capacity(); }
+    const_iterator begin() const { return const_iterator(bytes.data(), 0); }
+    const_iterator end() const { return const_iterator(bytes.data() + bytes.size(), last); }
+};
+
+// Sliding window over the source. Bytes before `mark` are dropped on each
+// refill and the rest move to the front of the buffer, so memory stays at
+// one chunk plus the longest lexeme no matter how large the input is. A
+// window over an in-memory string holds all of it and never refills.
+class SourceWindow {
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    istream* in = nullptr;
+    vector<char> storage;
+
+public:
+    const char* pos;  // next byte to lex
+    const char* mark; // first byte refill() must keep: the current lexeme
+    const char* end;  // end of the bytes read so far
+
+    explicit SourceWindow(istream& input) : in(&input) {
+        pos = mark = end = storage.data();
+        refill();
+    }
+
+    explicit SourceWindow(string_view text) : pos(text.data()), mark(text.data()), end(text.data() + text.size()) {}
+
+    // Read more input; false once the input is exhausted
+    bool refill() {
+        if (!in) {
+            return false;
+        }
+        size_t posOffset = pos - mark;
+        storage.erase(storage.begin(), storage.begin() + (mark - storage.data()));
+        size_t kept = storage.size();
+        storage.resize(kept + CHUNK_SIZE);
+        in->read(storage.data() + kept, CHUNK_SIZE);
+        size_t got = in->gcount();
+        storage.resize(kept + got);
+        mark = storage.data();
+        pos = mark + posOffset;
+        end = mark + storage.size();
+        return got > 0;
+    }
+
+    // Make n bytes available at pos unless the input ends first
+    bool ensure(size_t n) {
+        while ((size_t)(end - pos) < n) {
+            if (!refill()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t bufferBytes() const { return storage.capacity(); }
+};
+
 struct SymbolTableEntry {
     int entryNo;
-    string lexeme;
+    string_view lexeme; // stored in the analyzer's StringArena
     string tokenType;
     int lineDeclared;
-    vector<int> linesUsed;
+    LineList linesUsed;
 };
 
 class LexicalAnalyzer {
 private:
-  
-    unordered_set<string> keywords = {
-        "int", "float", "char", "double", "bool", "void", "return",
-        "if", "else", "while", "for", "do", "switch", "case", "break",
-        "continue", "class", "struct", "public", "private", "protected",
-        "new", "delete", "this", "const", "static", "using", "namespace"
-    };
 
     vector<SymbolTableEntry> symbolTable;
     int entryCounter = 1;
 
+    // Identifier index: open addressing with linear probing over a
+    // power-of-two table, kept at most half full. Each slot holds the
+    // lexeme hash and symbolTable index + 1 (0 marks an empty slot).
+    struct Slot {
+        uint32_t hash;
+        uint32_t entry;
+    };
+    StringArena lexemes;
+    vector<Slot> identifierSlots = vector<Slot>(1024);
+    size_t identifierCount = 0;
+
+    void growIdentifierSlots() {
+        vector<Slot> old(identifierSlots.size() * 2);
+        old.swap(identifierSlots);
+        size_t mask = identifierSlots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.entry) {
+                size_t i = slot.hash & mask;
+                while (identifierSlots[i].entry) {
+                    i = (i + 1) & mask;
+                }
+                identifierSlots[i] = slot;
+            }
+        }
+    }
+
     
     bool isOperator(char c) {
         string ops = "+-*/%<>=!&|";
@@ -45,81 +431,117 @@ private:
     }
 
     
-    void addToSymbolTable(const string& lexeme, const string& type, int line) {
+    void addToSymbolTable(string_view lexeme, const string& type, int line) {
         
+        Slot* slot = nullptr;
+        uint32_t hash = 0;
         if (type == "Identifier") {
-            for (auto& entry : symbolTable) {
-                if (entry.lexeme == lexeme && entry.tokenType == "Identifier") {
+            if (2 * (identifierCount + 1) > identifierSlots.size()) {
+                growIdentifierSlots();
+            }
+            hash = hashLexeme(lexeme);
+            size_t mask = identifierSlots.size() - 1;
+            size_t i = hash & mask;
+            while (identifierSlots[i].entry) {
+                SymbolTableEntry& entry = symbolTable[identifierSlots[i].entry - 1];
+                if (identifierSlots[i].hash == hash && entry.lexeme == lexeme) {
                     entry.linesUsed.push_back(line);
                     return; 
                 }
+                i = (i + 1) & mask;
             }
+            slot = &identifierSlots[i];
         }
 
         
         SymbolTableEntry newEntry;
         newEntry.entryNo = entryCounter++;
-        newEntry.lexeme = lexeme;
+        newEntry.lexeme = lexemes.store(lexeme);
         newEntry.tokenType = type;
         newEntry.lineDeclared = line;
         newEntry.linesUsed.push_back(line);
-        symbolTable.push_back(newEntry);
+        symbolTable.push_back(move(newEntry));
+        if (slot) {
+            *slot = {hash, (uint32_t)symbolTable.size()};
+            identifierCount++;
+        }
     }
 
 
 public:
     
-    void analyze(const string& sourceCode) {
-        int currentPos = 0;
+    // Lex the whole input, refilling the window as needed. Every token is
+    // finished before the next refill, so the string_views into the window
+    // are only used while they are valid.
+    void analyze(SourceWindow& w) {
         int line = 1;
 
-        while (currentPos < sourceCode.length()) {
-            char currentChar = sourceCode[currentPos];
+        for (;;) {
+            w.mark = w.pos;
+            if (w.pos == w.end && !w.refill()) {
+                break;
+            }
+            char currentChar = *w.pos;
 
             
-            if (isspace(currentChar)) {
-                if (currentChar == '\n') {
-                    line++;
+            if (isSpaceByte((unsigned char)currentChar)) {
+                for (;;) {
+                    const char* next = skipSpaces(w.pos, w.end);
+                    line += countByte(w.pos, next, '\n');
+                    w.pos = w.mark = next;
+                    if (next < w.end || !w.refill()) {
+                        break;
+                    }
                 }
-                currentPos++;
                 continue;
             }
 
             
-            if (currentChar == '/' && currentPos + 1 < sourceCode.length() && sourceCode[currentPos + 1] == '/') {
-                while (currentPos < sourceCode.length() && sourceCode[currentPos] != '\n') {
-                    currentPos++;
+            if (currentChar == '/' && w.ensure(2) && w.pos[1] == '/') {
+                for (;;) {
+                    w.pos = w.mark = findByte(w.pos, w.end, '\n');
+                    if (w.pos < w.end || !w.refill()) {
+                        break;
+                    }
                 }
                 continue;
             }
             
-            if (currentChar == '/' && currentPos + 1 < sourceCode.length() && sourceCode[currentPos + 1] == '*') {
-                int startPos = currentPos;
-                currentPos += 2;
-                while (currentPos + 1 < sourceCode.length() &&
-                       !(sourceCode[currentPos] == '*' && sourceCode[currentPos + 1] == '/')) {
-                    if (sourceCode[currentPos] == '\n') {
-                        line++;
+            if (currentChar == '/' && w.ensure(2) && w.pos[1] == '*') {
+                w.pos += 2;
+                for (;;) {
+                    const char* close = findCommentClose(w.pos, w.end);
+                    if (close != w.end) {
+                        line += countByte(w.pos, close, '\n');
+                        w.pos = close + 2;
+                        break;
+                    }
+                    // Keep the last byte: it may be the '*' of a "*/" cut by the refill.
+                    // An unterminated comment is thus scanned up to, but not including, the last byte.
+                    const char* keep = max(w.pos, w.end - 1);
+                    line += countByte(w.pos, keep, '\n');
+                    w.pos = w.mark = keep;
+                    if (!w.refill()) {
+                         cerr << "Lexical Error: Unterminated multi-line comment starting at line " << line << endl;
+                         return;
                     }
-                    currentPos++;
-                }
-                if (currentPos + 1 >= sourceCode.length()) {
-                     cerr << "Lexical Error: Unterminated multi-line comment starting at line " << line << endl;
-                     return;
                 }
-                currentPos += 2; 
                 continue;
             }
 
             
             if (isalpha(currentChar) || currentChar == '_') {
-                string lexeme;
-                while (currentPos < sourceCode.length() && (isalnum(sourceCode[currentPos]) || sourceCode[currentPos] == '_')) {
-                    lexeme += sourceCode[currentPos];
-                    currentPos++;
+                for (;;) {
+                    while (w.pos < w.end && (isalnum(*w.pos) || *w.pos == '_')) {
+                        w.pos++;
+                    }
+                    if (w.pos < w.end || !w.refill()) {
+                        break;
+                    }
                 }
+                string_view lexeme(w.mark, w.pos - w.mark);
 
-                if (keywords.count(lexeme)) {
+                if (classifyKeyword(lexeme) != Keyword::None) {
                     
                     cout << "Token: Keyword, Lexeme: " << lexeme << ", Line: " << line << endl;
                 } else {
@@ -132,16 +554,24 @@ public:
 
             
             if (isdigit(currentChar)) {
-                string lexeme;
                 bool isFloat = false;
-                while (currentPos < sourceCode.length() && (isdigit(sourceCode[currentPos]) || sourceCode[currentPos] == '.')) {
-                    if (sourceCode[currentPos] == '.') {
-                        if (isFloat) break; 
-                        isFloat = true;
+                bool secondDot = false;
+                for (;;) {
+                    while (w.pos < w.end && (isdigit(*w.pos) || *w.pos == '.')) {
+                        if (*w.pos == '.') {
+                            if (isFloat) {
+                                secondDot = true;
+                                break;
+                            }
+                            isFloat = true;
+                        }
+                        w.pos++;
+                    }
+                    if (secondDot || w.pos < w.end || !w.refill()) {
+                        break;
                     }
-                    lexeme += sourceCode[currentPos];
-                    currentPos++;
                 }
+                string_view lexeme(w.mark, w.pos - w.mark);
                 string type = isFloat ? "Float" : "Integer";
                 cout << "Token: " << type << ", Lexeme: " << lexeme << ", Line: " << line << endl;
                 addToSymbolTable(lexeme, type, line);
@@ -150,35 +580,36 @@ public:
 
           
             if (currentChar == '"') {
-                string lexeme;
-                lexeme += currentChar;
-                currentPos++;
-                while (currentPos < sourceCode.length() && sourceCode[currentPos] != '"') {
-                    if (sourceCode[currentPos] == '\n') line++; 
-                    lexeme += sourceCode[currentPos];
-                    currentPos++;
-                }
-                if (currentPos < sourceCode.length() && sourceCode[currentPos] == '"') {
-                    lexeme += sourceCode[currentPos];
-                    currentPos++;
-                    cout << "Token: Literal, Lexeme: " << lexeme << ", Line: " << line << endl;
-                    addToSymbolTable(lexeme, "Literal", line);
-                } else {
-                    cerr << "Lexical Error: Unterminated string literal at line " << line << endl;
+                size_t scanned = 1; // bytes after mark already searched for the closing quote
+                for (;;) {
+                    const char* close = findByte(w.mark + scanned, w.end, '"');
+                    line += countByte(w.mark + scanned, close, '\n');
+                    if (close < w.end) {
+                        w.pos = close + 1;
+                        string_view lexeme(w.mark, w.pos - w.mark);
+                        cout << "Token: Literal, Lexeme: " << lexeme << ", Line: " << line << endl;
+                        addToSymbolTable(lexeme, "Literal", line);
+                        break;
+                    }
+                    scanned = w.end - w.mark;
+                    if (!w.refill()) {
+                        w.pos = w.end;
+                        cerr << "Lexical Error: Unterminated string literal at line " << line << endl;
+                        break;
+                    }
                 }
                 continue;
             }
 
            
             if (isOperator(currentChar)) {
-                string lexeme;
-                lexeme += currentChar;
+                size_t length = 1;
                 
-                if (currentPos + 1 < sourceCode.length() && isOperator(sourceCode[currentPos+1])) {
-                     lexeme += sourceCode[currentPos+1];
-                     currentPos++;
+                if (w.ensure(2) && isOperator(w.pos[1])) {
+                     length = 2;
                 }
-                currentPos++;
+                string_view lexeme(w.pos, length);
+                w.pos += length;
                 cout << "Token: Operator, Lexeme: " << lexeme << ", Line: " << line << endl;
                 
                 continue;
@@ -187,16 +618,41 @@ public:
 
             if (isSpecialSymbol(currentChar)) {
                 cout << "Token: Special Symbol, Lexeme: " << string(1, currentChar) << ", Line: " << line << endl;
-                currentPos++;
+                w.pos++;
                 continue;
             }
 
             
             cerr << "Lexical Error: Unrecognized token '" << currentChar << "' at line " << line << endl;
-            currentPos++;
+            w.pos++;
         }
     }
 
+    void analyze(istream& input) {
+        SourceWindow window(input);
+        analyze(window);
+    }
+
+    void analyze(const string& sourceCode) {
+        SourceWindow window(sourceCode);
+        analyze(window);
+    }
+
+    
+    size_t symbolCount() const {
+        return symbolTable.size();
+    }
+
+    // Occurrences recorded in linesUsed, and the bytes holding them
+    pair<size_t, size_t> lineStorage() const {
+        size_t occurrences = 0, bytes = 0;
+        for (const auto& entry : symbolTable) {
+            occurrences += entry.linesUsed.size();
+            bytes += entry.linesUsed.memoryBytes();
+        }
+        return {occurrences, bytes};
+    }
+
     
     void printSymbolTable() {
         cout << "\n\n--- Symbol Table ---\n";
@@ -214,15 +670,195 @@ public:
                       << setw(15) << entry.lineDeclared;
             
             string usedLinesStr;
-            for(size_t i = 0; i < entry.linesUsed.size(); ++i) {
-                usedLinesStr += to_string(entry.linesUsed[i]) + (i == entry.linesUsed.size() - 1 ? "" : ", ");
+            for (int usedLine : entry.linesUsed) {
+                usedLinesStr += (usedLinesStr.empty() ? "" : ", ") + to_string(usedLine);
             }
             cout << usedLinesStr << endl;
         }
     }
 };
 
-int main() {
+// Cross-check the vector kernels against the scalar ones on random buffers,
+// then time both on long runs with no match
+void benchmarkKernels() {
+    using clock = chrono::steady_clock;
+
+    mt19937 rng(12345);
+    const string alphabet = " \t\n\r*/\"ab";
+    string buffer;
+    int mismatches = 0;
+    const int cases = 20000;
+    for (int c = 0; c < cases; ++c) {
+        buffer.resize(rng() % 200);
+        int spread = 1 + rng() % alphabet.size();
+        for (char& ch : buffer) {
+            ch = alphabet[rng() % spread];
+        }
+        const char* end = buffer.data() + buffer.size();
+        const char* p = buffer.data() + (buffer.empty() ? 0 : rng() % buffer.size());
+        mismatches += skipSpaces(p, end) != skipSpacesScalar(p, end);
+        mismatches += findByte(p, end, '"') != findByteScalar(p, end, '"');
+        mismatches += findCommentClose(p, end) != findCommentCloseScalar(p, end);
+        mismatches += countByte(p, end, '\n') != countByteScalar(p, end, '\n');
+    }
+    cout << "Fuzz check: " << cases << " buffers, " << mismatches << " mismatches\n\n";
+
+    const size_t size = 64 << 20;
+    string spaces(size, ' ');
+    string text(size, 'a');
+    string stars(size, '*');
+    for (size_t i = 0; i < size; i += 3) {
+        spaces[i] = '\n';
+    }
+
+    auto run = [&](const char* label, const string& input, auto kernel) {
+        auto t0 = clock::now();
+        size_t result = kernel(input.data(), input.data() + input.size());
+        double secs = chrono::duration<double>(clock::now() - t0).count();
+        cout << label << size / secs / 1e9 << " GB/s (" << result << ")\n";
+    };
+    auto offset = [](const string& input, auto kernel) {
+        return [&input, kernel](const char* p, const char* e) { return (size_t)(kernel(p, e) - input.data()); };
+    };
+
+    run("skipSpaces scalar       : ", spaces, offset(spaces, skipSpacesScalar));
+    run("skipSpaces vector       : ", spaces, offset(spaces, skipSpaces));
+    run("findByte scalar         : ", text, offset(text, [](const char* p, const char* e) { return findByteScalar(p, e, '"'); }));
+    run("findByte vector         : ", text, offset(text, [](const char* p, const char* e) { return findByte(p, e, '"'); }));
+    run("findCommentClose scalar : ", stars, offset(stars, findCommentCloseScalar));
+    run("findCommentClose vector : ", stars, offset(stars, findCommentClose));
+    run("countByte scalar        : ", spaces, [](const char* p, const char* e) { return countByteScalar(p, e, '\n'); });
+    run("countByte vector        : ", spaces, [](const char* p, const char* e) { return countByte(p, e, '\n'); });
+}
+
+// Discards everything written to it; used to time analyze() without its
+// per-token report
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+void reportLineStorage(const LexicalAnalyzer& analyzer) {
+    auto [occurrences, bytes] = analyzer.lineStorage();
+    cout << "Line occurrences: " << occurrences << " stored in " << bytes / 1024.0 << " KB (vector<int> needs at least "
+         << occurrences * sizeof(int) / 1024.0 << " KB)\n";
+}
+
+double timeAnalyze(LexicalAnalyzer& analyzer, const string& source) {
+    NullBuffer nullBuffer;
+    streambuf* saved = cout.rdbuf(&nullBuffer);
+    auto t0 = chrono::steady_clock::now();
+    analyzer.analyze(source);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout.rdbuf(saved);
+    return secs;
+}
+
+// Time analyze() on generated code with `distinct` different identifiers,
+// each declared once and used again on a later line, then on code where a
+// few identifiers are used `distinct` times each
+void benchmarkSymbolTable(size_t distinct) {
+    string source;
+    for (size_t i = 0; i < distinct; ++i) {
+        source += "int id_" + to_string(i) + " = id_" + to_string(i / 2) + " + " + to_string(i % 10) + ";\n";
+    }
+
+    LexicalAnalyzer analyzer;
+    double secs = timeAnalyze(analyzer, source);
+    cout << "Source: " << source.size() / (1024.0 * 1024.0) << " MB, " << distinct << " distinct identifiers, "
+         << 2 * distinct << " identifier occurrences\n";
+    cout << "analyze(): " << secs * 1000 << " ms, " << analyzer.symbolCount() << " symbol table entries, "
+         << 2 * distinct / secs / 1e6 << " M identifier lookups/s\n";
+    reportLineStorage(analyzer);
+
+    string hot;
+    for (size_t i = 0; i < distinct; ++i) {
+        hot += (i % 1000 == 0) ? "total = total + count * scale;\n" : "total = total + count;\n";
+    }
+    LexicalAnalyzer hotAnalyzer;
+    secs = timeAnalyze(hotAnalyzer, hot);
+    cout << "\nSource: " << hot.size() / (1024.0 * 1024.0) << " MB, 3 identifiers used on " << distinct << " lines\n";
+    cout << "analyze(): " << secs * 1000 << " ms\n";
+    reportLineStorage(hotAnalyzer);
+}
+
+// Hashes everything written to it, so two runs' reports can be compared
+// without keeping them
+class HashBuffer : public streambuf {
+public:
+    uint64_t hash = 1469598103934665603ull;
+
+protected:
+    int overflow(int c) override {
+        if (c != EOF) {
+            hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+        }
+        return c;
+    }
+    streamsize xsputn(const char* s, streamsize n) override {
+        for (streamsize i = 0; i < n; ++i) {
+            hash = (hash ^ (unsigned char)s[i]) * 1099511628211ull;
+        }
+        return n;
+    }
+};
+
+// Analyze a file once from a string holding all of it and once streamed
+// through a SourceWindow, then compare the reports and the memory held
+int benchmarkStreaming(const string& filename) {
+    using clock = chrono::steady_clock;
+
+    ifstream whole(filename, ios::binary);
+    if (!whole.is_open()) {
+        cerr << "Error: Could not open file '" << filename << "'" << endl;
+        return 1;
+    }
+    auto t0 = clock::now();
+    stringstream buffer;
+    buffer << whole.rdbuf();
+    string sourceCode = buffer.str();
+    HashBuffer wholeHash;
+    streambuf* savedOut = cout.rdbuf(&wholeHash);
+    streambuf* savedErr = cerr.rdbuf(&wholeHash);
+    LexicalAnalyzer wholeAnalyzer;
+    wholeAnalyzer.analyze(sourceCode);
+    wholeAnalyzer.printSymbolTable();
+    double wholeSecs = chrono::duration<double>(clock::now() - t0).count();
+
+    ifstream streamed(filename, ios::binary);
+    auto t1 = clock::now();
+    HashBuffer streamHash;
+    cout.rdbuf(&streamHash);
+    cerr.rdbuf(&streamHash);
+    LexicalAnalyzer streamAnalyzer;
+    SourceWindow window(streamed);
+    streamAnalyzer.analyze(window);
+    streamAnalyzer.printSymbolTable();
+    double streamSecs = chrono::duration<double>(clock::now() - t1).count();
+    cout.rdbuf(savedOut);
+    cerr.rdbuf(savedErr);
+
+    cout << "Source: " << sourceCode.size() / (1024.0 * 1024.0) << " MB\n";
+    cout << "whole file : " << wholeSecs * 1000 << " ms, " << sourceCode.capacity() / 1024.0 << " KB source buffer\n";
+    cout << "streamed   : " << streamSecs * 1000 << " ms, " << window.bufferBytes() / 1024.0 << " KB window\n";
+    cout << "Reports " << (wholeHash.hash == streamHash.hash ? "match" : "DIFFER") << "\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 3 && string(argv[1]) == "--bench-stream") {
+        return benchmarkStreaming(argv[2]);
+    }
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--bench") {
+        benchmarkSymbolTable(argc == 3 ? stoul(argv[2]) : 100000);
+        return 0;
+    }
+    if (argc == 2 && string(argv[1]) == "--bench-simd") {
+        benchmarkKernels();
+        return 0;
+    }
+
     string filename;
     cout << "Enter the source code filename: ";
     cin >> filename;
@@ -235,15 +871,9 @@ int main() {
     }
 
     
-    stringstream buffer;
-    buffer << inputFile.rdbuf();
-    string sourceCode = buffer.str();
-    inputFile.close();
-
-    
     LexicalAnalyzer analyzer;
     cout << "\n--- Analyzing Code from " << filename << " ---\n" << endl;
-    analyzer.analyze(sourceCode);
+    analyzer.analyze(inputFile);
     analyzer.printSymbolTable();
 
  
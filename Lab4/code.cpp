@@ -1,6 +1,134 @@
 #include <bits/stdc++.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 using namespace std;
 
+// dst[i] |= src[i] for n words
+static void orWords(uint64_t *dst, const uint64_t *src, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(a, b));
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(a, b));
+    }
+#endif
+    for (; i < n; ++i)
+        dst[i] |= src[i];
+}
+
+// Set of positions as a bitset over the 64-bit words it actually touches.
+// words never begins or ends with a zero word, so equal sets have equal
+// (base, words) and sets of nearby positions stay a few words long.
+struct PosSet
+{
+    int base = 0; // word index of words[0]
+    vector<uint64_t> words;
+
+    bool empty() const { return words.empty(); }
+
+    void clear()
+    {
+        base = 0;
+        words.clear();
+    }
+
+    void insert(int p)
+    {
+        int w = p >> 6;
+        uint64_t bit = uint64_t(1) << (p & 63);
+        if (words.empty())
+        {
+            base = w;
+            words.assign(1, bit);
+            return;
+        }
+        if (w < base)
+        {
+            words.insert(words.begin(), base - w, 0);
+            base = w;
+        }
+        else if (w - base >= (int)words.size())
+            words.resize(w - base + 1, 0);
+        words[w - base] |= bit;
+    }
+
+    bool contains(int p) const
+    {
+        int w = (p >> 6) - base;
+        return w >= 0 && w < (int)words.size() && ((words[w] >> (p & 63)) & 1);
+    }
+
+    // this |= o
+    void unite(const PosSet &o)
+    {
+        if (o.words.empty())
+            return;
+        if (words.empty())
+        {
+            *this = o;
+            return;
+        }
+        int lo = min(base, o.base);
+        int hi = max(base + (int)words.size(), o.base + (int)o.words.size());
+        if (lo < base)
+        {
+            words.insert(words.begin(), base - lo, 0);
+            base = lo;
+        }
+        if ((int)words.size() < hi - base)
+            words.resize(hi - base, 0);
+        orWords(words.data() + (o.base - base), o.words.data(), o.words.size());
+    }
+
+    // Call f(p) for every position in ascending order
+    template <class F>
+    void forEach(F f) const
+    {
+        for (size_t i = 0; i < words.size(); ++i)
+            for (uint64_t w = words[i]; w; w &= w - 1)
+                f((base + (int)i) * 64 + __builtin_ctzll(w));
+    }
+
+    bool intersects(const PosSet &o) const
+    {
+        int lo = max(base, o.base);
+        int hi = min(base + (int)words.size(), o.base + (int)o.words.size());
+        for (int w = lo; w < hi; ++w)
+            if (words[w - base] & o.words[w - o.base])
+                return true;
+        return false;
+    }
+
+    bool operator==(const PosSet &o) const { return base == o.base && words == o.words; }
+    bool operator<(const PosSet &o) const { return base != o.base ? base < o.base : words < o.words; }
+};
+
+static PosSet singleton(int p)
+{
+    PosSet s;
+    s.insert(p);
+    return s;
+}
+
 // Node for syntax tree
 struct TreeNode
 {
@@ -8,8 +136,8 @@ struct TreeNode
     TreeNode *left;
     TreeNode *right;
     bool isNullable;
-    set<int> startPos;
-    set<int> endPos;
+    PosSet startPos;
+    PosSet endPos;
     int position;
     int id;
 
@@ -18,123 +146,286 @@ struct TreeNode
           position(0), id(0) {}
 };
 
-// Global trackers
-static int posCounter = 0;
-static int idCounter = 0;
-static map<int, set<int>> nextPositions;
-static map<int, char> positionSymbol;
-static vector<TreeNode *> nodesPool;
-
-// Merge two sets
-static set<int> mergeSets(const set<int> &a, const set<int> &b)
+// Bump allocator for syntax tree nodes: nodes are placed one after another
+// in fixed-size blocks and destroyed together by reset(), which keeps the
+// blocks for reuse
+class NodeArena
 {
-    set<int> result(a);
-    result.insert(b.begin(), b.end());
-    return result;
-}
+    static constexpr size_t BLOCK_NODES = 1024;
+    vector<unique_ptr<char[]>> blocks;
+    size_t used = 0; // nodes alive, filling blocks in order
 
-// Build syntax tree from postfix regex
-TreeNode *constructSyntaxTree(const string &postfix)
-{
-    stack<TreeNode *> st;
-    for (char ch : postfix)
+    TreeNode *slot(size_t i) const
     {
-        if (ch == '*' || ch == '|' || ch == '.')
-        {
-            TreeNode *node = new TreeNode(ch);
-            node->id = ++idCounter;
-            nodesPool.push_back(node);
-            if (ch == '*')
-            {
-                node->left = st.top();
-                st.pop();
-            }
-            else
-            {
-                node->right = st.top();
-                st.pop();
-                node->left = st.top();
-                st.pop();
-            }
-            st.push(node);
-        }
-        else
-        {
-            TreeNode *leaf = new TreeNode(ch);
-            leaf->id = ++idCounter;
-            leaf->position = ++posCounter;
-            positionSymbol[leaf->position] = ch;
-            nodesPool.push_back(leaf);
-            st.push(leaf);
-        }
+        return reinterpret_cast<TreeNode *>(blocks[i / BLOCK_NODES].get()) + i % BLOCK_NODES;
     }
-    return st.top();
-}
 
-// Compute nullable, firstPos, lastPos
-void analyzeTree(TreeNode *root)
-{
-    if (!root)
-        return;
-    if (!root->left && !root->right)
+public:
+    NodeArena() = default;
+    NodeArena(const NodeArena &) = delete;
+    NodeArena &operator=(const NodeArena &) = delete;
+    ~NodeArena() { reset(); }
+
+    TreeNode *make(char op)
     {
-        root->isNullable = false;
-        root->startPos = {root->position};
-        root->endPos = {root->position};
-        return;
+        if (used == blocks.size() * BLOCK_NODES)
+            blocks.emplace_back(new char[BLOCK_NODES * sizeof(TreeNode)]);
+        return new (slot(used++)) TreeNode(op);
     }
-    if (root->value == '|')
+
+    void reset()
     {
-        analyzeTree(root->left);
-        analyzeTree(root->right);
-        root->isNullable = root->left->isNullable || root->right->isNullable;
-        root->startPos = mergeSets(root->left->startPos, root->right->startPos);
-        root->endPos = mergeSets(root->left->endPos, root->right->endPos);
+        for (size_t i = 0; i < used; ++i)
+            slot(i)->~TreeNode();
+        used = 0;
     }
-    else if (root->value == '.')
+};
+
+// Nodes of the tree under root, every child before its parent. Pushing
+// children after their parent gives a pre-order with the right subtree
+// first; reversed, it is a post-order. No recursion, so degenerate trees
+// millions of nodes deep are fine.
+static vector<TreeNode *> postOrder(TreeNode *root)
+{
+    vector<TreeNode *> order, pending;
+    if (root)
+        pending.push_back(root);
+    while (!pending.empty())
     {
-        analyzeTree(root->left);
-        analyzeTree(root->right);
-        root->isNullable = root->left->isNullable && root->right->isNullable;
-        root->startPos = root->left->isNullable ? mergeSets(root->left->startPos, root->right->startPos) : root->left->startPos;
-        root->endPos = root->right->isNullable ? mergeSets(root->right->endPos, root->left->endPos) : root->right->endPos;
+        TreeNode *node = pending.back();
+        pending.pop_back();
+        order.push_back(node);
+        if (node->left)
+            pending.push_back(node->left);
+        if (node->right)
+            pending.push_back(node->right);
     }
-    else if (root->value == '*')
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+// Regex token: an operator, or a leaf (op == 0) reading a byte-set
+struct RegexToken
+{
+    char op;           // '(', ')', '|', '.', '*', '+', '?', '{' or 0
+    bitset<256> bytes; // leaf bytes; none for the end marker '#'
+    string text;       // spelling, for display
+    int lo = 0, hi = 0; // bounds of {m,n}; hi < 0 when unbounded
+};
+
+static bool isPostfixOp(char op)
+{
+    return op == '*' || op == '+' || op == '?' || op == '{';
+}
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = (char)tolower((unsigned char)c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+// Bytes of the escape starting after the backslash at expr[i]; i is left
+// on the escape's last character
+static bitset<256> escapeBytes(const string &expr, size_t &i)
+{
+    if (i >= expr.size())
+        throw runtime_error("regex ends in a backslash");
+    bitset<256> set;
+    char c = expr[i];
+    auto addRange = [&](int from, int to)
+    {
+        for (int b = from; b <= to; ++b)
+            set.set(b);
+    };
+    switch (c)
     {
-        analyzeTree(root->left);
-        root->isNullable = true;
-        root->startPos = root->left->startPos;
-        root->endPos = root->left->endPos;
+    case 'd':
+    case 'D':
+        addRange('0', '9');
+        break;
+    case 'w':
+    case 'W':
+        addRange('0', '9');
+        addRange('A', 'Z');
+        addRange('a', 'z');
+        set.set('_');
+        break;
+    case 's':
+    case 'S':
+        for (char ws : string(" \t\n\r\f\v"))
+            set.set((unsigned char)ws);
+        break;
+    case 'n':
+        set.set('\n');
+        break;
+    case 't':
+        set.set('\t');
+        break;
+    case 'r':
+        set.set('\r');
+        break;
+    case 'f':
+        set.set('\f');
+        break;
+    case 'v':
+        set.set('\v');
+        break;
+    case '0':
+        set.set(0);
+        break;
+    case 'x':
+    {
+        int h = i + 2 < expr.size() ? hexDigit(expr[i + 1]) : -1;
+        int l = i + 2 < expr.size() ? hexDigit(expr[i + 2]) : -1;
+        if (h < 0 || l < 0)
+            throw runtime_error("\\x needs two hex digits");
+        set.set(h * 16 + l);
+        i += 2;
+        break;
+    }
+    default:
+        set.set((unsigned char)c);
     }
+    if (c == 'D' || c == 'W' || c == 'S')
+        set.flip();
+    return set;
 }
 
-// Populate followpos (nextPositions)
-void buildNextPositions(TreeNode *root)
+// Parse a bracket class starting at expr[i] == '['; i is left on the ']'
+static bitset<256> classBytes(const string &expr, size_t &i)
 {
-    if (!root)
-        return;
-    buildNextPositions(root->left);
-    buildNextPositions(root->right);
-    if (root->value == '.')
+    bitset<256> set;
+    bool negate = i + 1 < expr.size() && expr[i + 1] == '^';
+    i += negate ? 2 : 1;
+    bool first = true;
+    while (i < expr.size() && (expr[i] != ']' || first))
     {
-        for (int p : root->left->endPos)
+        first = false;
+        bitset<256> item;
+        int low = -1;
+        if (expr[i] == '\\')
+        {
+            item = escapeBytes(expr, ++i);
+            if (item.count() == 1)
+                for (int b = 0; b < 256; ++b)
+                    if (item[b])
+                        low = b;
+        }
+        else
         {
-            nextPositions[p] = mergeSets(nextPositions[p], root->right->startPos);
+            low = (unsigned char)expr[i];
+            item.set(low);
         }
+        // A range "x-y"; a '-' before ']' is a literal
+        if (low >= 0 && i + 2 < expr.size() && expr[i + 1] == '-' && expr[i + 2] != ']')
+        {
+            i += 2;
+            bitset<256> upper = expr[i] == '\\' ? escapeBytes(expr, ++i) : bitset<256>().set((unsigned char)expr[i]);
+            int high = -1;
+            for (int b = 0; b < 256; ++b)
+                if (upper[b])
+                    high = b;
+            if (upper.count() != 1 || high < low)
+                throw runtime_error("bad range in character class");
+            for (int b = low; b <= high; ++b)
+                item.set(b);
+        }
+        set |= item;
+        ++i;
     }
-    else if (root->value == '*')
+    if (i >= expr.size())
+        throw runtime_error("unterminated character class");
+    if (negate)
+        set.flip();
+    if (set.none())
+        throw runtime_error("empty character class");
+    return set;
+}
+
+// Split a regex into tokens. Besides '|', '*' and parentheses this knows
+// '+', '?', {m}, {m,}, {m,n}, '.', bracket classes and backslash escapes;
+// '#' is the end marker and any other byte matches itself. Bounds are
+// decimal, at most 1000, and n >= 1: there is no empty-string leaf for
+// {0} or {0,0} to become.
+vector<RegexToken> tokenizeRegex(const string &expr)
+{
+    vector<RegexToken> tokens;
+    for (size_t i = 0; i < expr.size(); ++i)
     {
-        for (int p : root->endPos)
+        RegexToken tok{0, {}, string(1, expr[i])};
+        size_t begin = i;
+        char c = expr[i];
+        switch (c)
         {
-            nextPositions[p] = mergeSets(nextPositions[p], root->startPos);
+        case '(':
+        case ')':
+        case '|':
+        case '*':
+        case '+':
+        case '?':
+            tok.op = c;
+            break;
+        case '{':
+        {
+            size_t close = expr.find('}', i);
+            if (close == string::npos)
+                throw runtime_error("unterminated {m,n}");
+            string body = expr.substr(i + 1, close - i - 1);
+            size_t comma = body.find(',');
+            // A bound is all digits: stoi alone would take "2x" as 2
+            auto bound = [](const string &field)
+            {
+                size_t used = 0;
+                int value = field.empty() || !isdigit((unsigned char)field[0]) ? -1 : stoi(field, &used);
+                if (used != field.size())
+                    throw invalid_argument(field);
+                return value;
+            };
+            try
+            {
+                tok.lo = bound(body.substr(0, comma));
+                tok.hi = comma == string::npos ? tok.lo : comma + 1 == body.size() ? -1 : bound(body.substr(comma + 1));
+            }
+            catch (const logic_error &)
+            {
+                throw runtime_error("bad repetition {" + body + "}");
+            }
+            if (tok.hi == 0)
+                throw runtime_error("repetition {" + body + "} matches only the empty string, which is not supported");
+            if (tok.lo < 0 || (tok.hi >= 0 && tok.hi < tok.lo) || max(tok.lo, tok.hi) > 1000)
+                throw runtime_error("bad repetition {" + body + "}");
+            tok.op = '{';
+            i = close;
+            break;
         }
+        case '[':
+            tok.bytes = classBytes(expr, i);
+            break;
+        case '\\':
+            tok.bytes = escapeBytes(expr, ++i);
+            break;
+        case '.':
+            tok.bytes.set().reset('\n');
+            break;
+        case '#':
+            break;
+        default:
+            tok.bytes.set((unsigned char)c);
+        }
+        tok.text = expr.substr(begin, i - begin + 1);
+        tokens.push_back(tok);
     }
+    return tokens;
 }
 
 // Operator precedence for infix to postfix
 int opPrec(char c)
 {
-    if (c == '*')
+    if (isPostfixOp(c))
         return 3;
     if (c == '.')
         return 2;
@@ -144,236 +435,2357 @@ int opPrec(char c)
 }
 
 // Insert explicit '.' for concatenation
-string insertConcatOperators(const string &expr)
+vector<RegexToken> insertConcatOperators(const vector<RegexToken> &tokens)
 {
-    string out;
-    for (size_t i = 0; i < expr.size(); ++i)
+    vector<RegexToken> out;
+    for (size_t i = 0; i < tokens.size(); ++i)
     {
-        char a = expr[i];
-        out += a;
+        char a = tokens[i].op;
+        out.push_back(tokens[i]);
         if (a == '(' || a == '|')
             continue;
-        if (i + 1 < expr.size())
+        if (i + 1 < tokens.size())
         {
-            char b = expr[i + 1];
-            if (b == '*' || b == '|' || b == ')')
+            char b = tokens[i + 1].op;
+            if (isPostfixOp(b) || b == '|' || b == ')')
                 continue;
-            out += '.';
+            out.push_back({'.', {}, "."});
         }
     }
     return out;
 }
 
-// Convert regex from infix to postfix
-string infixToPostfix(const string &expr)
+// Convert regex from infix to postfix. Postfix operators bind tightest,
+// so they go straight to the output.
+vector<RegexToken> infixToPostfix(const vector<RegexToken> &expr)
 {
-    string res;
-    stack<char> stk;
-    for (char c : expr)
+    vector<RegexToken> res;
+    stack<RegexToken> stk;
+    for (const RegexToken &tok : expr)
     {
-        if (isalnum(c) || c == '#')
+        char c = tok.op;
+        if (!c || isPostfixOp(c))
         {
-            res += c;
+            res.push_back(tok);
         }
         else if (c == '(')
         {
-            stk.push(c);
+            stk.push(tok);
         }
         else if (c == ')')
         {
-            while (!stk.empty() && stk.top() != '(')
+            while (!stk.empty() && stk.top().op != '(')
             {
-                res += stk.top();
+                res.push_back(stk.top());
                 stk.pop();
             }
-            if (!stk.empty())
-                stk.pop();
+            if (stk.empty())
+                throw runtime_error("unbalanced ')' in regex");
+            stk.pop();
         }
         else
         {
-            while (!stk.empty() && opPrec(stk.top()) >= opPrec(c))
+            while (!stk.empty() && opPrec(stk.top().op) >= opPrec(c))
             {
-                res += stk.top();
+                res.push_back(stk.top());
                 stk.pop();
             }
-            stk.push(c);
+            stk.push(tok);
         }
     }
     while (!stk.empty())
     {
-        res += stk.top();
+        if (stk.top().op == '(')
+            throw runtime_error("unbalanced '(' in regex");
+        res.push_back(stk.top());
         stk.pop();
     }
     return res;
 }
 
+// Regex tokens as written
+string showRegex(const vector<RegexToken> &tokens)
+{
+    string out;
+    for (const RegexToken &tok : tokens)
+        out += tok.text;
+    return out;
+}
+
 // Stringify set
-string showSet(const set<int> &s)
+string showSet(const PosSet &s)
 {
     if (s.empty())
         return "{}";
     stringstream ss;
     ss << "{ ";
-    for (int x : s)
-        ss << x << ' ';
+    s.forEach([&](int x)
+              { ss << x << ' '; });
     ss << "}";
     return ss.str();
 }
 
-// Display node details
-void displayNodeDetails(TreeNode *node, int lvl = 0)
-{
-    if (!node)
-        return;
-    string pad(lvl * 2, ' ');
-    cout << pad << "Node " << node->id << " (" << node->value << ")";
-    if (node->position)
-        cout << " [pos=" << node->position << "]";
-    cout << ":\n";
-    cout << pad << " nullable: " << (node->isNullable ? "true" : "false") << "\n";
-    cout << pad << " firstpos: " << showSet(node->startPos) << "\n";
-    cout << pad << " lastpos: " << showSet(node->endPos) << "\n";
-    displayNodeDetails(node->left, lvl + 1);
-    displayNodeDetails(node->right, lvl + 1);
-}
-
-// DFA representation
+// DFA representation: bytes are compressed to alphabet classes and
+// transitions is a flat [state][class] table
 struct DFAState
 {
-    vector<set<int>> sets;
-    map<pair<int, char>, int> transitions;
-    map<int, bool> isAccept;
+    static constexpr uint32_t DEAD = UINT32_MAX;
+
+    vector<PosSet> sets;
+    array<uint8_t, 256> classOf{}; // class 0: bytes no position reads
+    int numClasses = 1;
+    vector<uint32_t> transitions;
+    vector<uint8_t> isAccept;
+    vector<int> acceptRule; // lowest rule whose end marker is in the state, or -1
     int start;
+
+    uint32_t next(int state, unsigned char ch) const
+    {
+        return transitions[(size_t)state * numClasses + classOf[ch]];
+    }
 };
 
-// Construct DFA
-DFAState buildDFA(TreeNode *root)
+// Read-only view of a DFA's tables, which is what the matchers run on.
+// It points either into a DFAState or into a mapped DFA file.
+struct DFATable
 {
-    DFAState dfa;
-    vector<set<int>> unmarked;
-    map<set<int>, int> idMap;
+    const uint32_t *transitions = nullptr;
+    const uint8_t *classOf = nullptr;
+    const uint8_t *isAccept = nullptr;
+    const int *acceptRule = nullptr;
+    uint32_t numStates = 0;
+    uint32_t numClasses = 1;
+    int start = -1;
 
-    unmarked.push_back(root->startPos);
-    idMap[root->startPos] = 0;
-    dfa.start = 0;
+    DFATable() = default;
+    DFATable(const DFAState &dfa)
+        : transitions(dfa.transitions.data()), classOf(dfa.classOf.data()), isAccept(dfa.isAccept.data()),
+          acceptRule(dfa.acceptRule.data()), numStates((uint32_t)dfa.isAccept.size()),
+          numClasses(dfa.numClasses), start(dfa.start) {}
+};
+
+// Hash a position set once; equal sets have equal words, so this is exact
+static uint64_t hashPosSet(const PosSet &s)
+{
+    uint64_t h = uint64_t(s.base) * 0x9E3779B97F4A7C15ULL;
+    for (uint64_t w : s.words)
+    {
+        h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+// DFA states interned by position set: one hash per set, then linear
+// probing over an open-addressing table instead of tree comparisons
+class StateTable
+{
+    struct Slot
+    {
+        uint64_t hash;
+        uint32_t state; // state id + 1, 0 when empty
+    };
+
+    vector<Slot> slots = vector<Slot>(1024);
 
-    size_t idx = 0;
-    while (idx < unmarked.size())
+    void grow()
     {
-        auto S = unmarked[idx];
-        map<char, set<int>> moves;
-        for (int p : S)
+        vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (const Slot &slot : old)
         {
-            char sym = positionSymbol[p];
-            if (sym == '#')
-                continue;
-            moves[sym] = mergeSets(moves[sym], nextPositions[p]);
+            if (slot.state)
+            {
+                size_t i = slot.hash & mask;
+                while (slots[i].state)
+                    i = (i + 1) & mask;
+                slots[i] = slot;
+            }
         }
-        for (auto &pr : moves)
+    }
+
+public:
+    vector<PosSet> sets;
+
+    void clear()
+    {
+        fill(slots.begin(), slots.end(), Slot{0, 0});
+        sets.clear();
+    }
+
+    // State id for s, or -1 if it has none
+    int find(const PosSet &s) const
+    {
+        uint64_t hash = hashPosSet(s);
+        size_t mask = slots.size() - 1;
+        for (size_t i = hash & mask; slots[i].state; i = (i + 1) & mask)
+            if (slots[i].hash == hash && sets[slots[i].state - 1] == s)
+                return slots[i].state - 1;
+        return -1;
+    }
+
+    // State id for s; inserted tells whether it is new
+    int intern(PosSet &&s, bool &inserted)
+    {
+        if (2 * (sets.size() + 1) > slots.size())
+            grow();
+        uint64_t hash = hashPosSet(s);
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i].state)
         {
-            char sym = pr.first;
-            auto &tgt = pr.second;
-            if (tgt.empty())
-                continue;
-            if (!idMap.count(tgt))
+            if (slots[i].hash == hash && sets[slots[i].state - 1] == s)
             {
-                idMap[tgt] = unmarked.size();
-                unmarked.push_back(tgt);
+                inserted = false;
+                return slots[i].state - 1;
             }
-            dfa.transitions[{(int)idx, sym}] = idMap[tgt];
+            i = (i + 1) & mask;
         }
-        ++idx;
+        sets.push_back(move(s));
+        slots[i] = {hash, (uint32_t)sets.size()};
+        inserted = true;
+        return (int)sets.size() - 1;
     }
+};
+
+// Compiles regexes to followpos DFAs. A compiler owns the syntax tree
+// nodes of the regex it is working on and every position table, so
+// compilers on different threads share nothing. Tables are numbered from
+// position 1 and start over with each reset().
+class RegexCompiler
+{
+    NodeArena nodes;
+
+public:
+    int posCounter = 0;
+    int idCounter = 0;
+    vector<PosSet> nextPositions;
+    vector<bitset<256>> positionBytes; // bytes each leaf reads; none for '#'
+    vector<string> positionLabel;      // leaf as written in the regex
+    vector<int> positionRule;          // rule of an end marker, else -1
 
-    int hashPos = -1;
-    for (auto &pr : positionSymbol)
+    RegexCompiler() { reset(); }
+
+    // Drop the current tree and tables before building a new regex; the
+    // arena keeps its blocks for the next one
+    void reset()
     {
-        if (pr.second == '#')
-            hashPos = pr.first;
+        posCounter = 0;
+        idCounter = 0;
+        positionBytes.assign(1, bitset<256>());
+        positionLabel.assign(1, string());
+        positionRule.assign(1, -1);
+        nextPositions.assign(1, PosSet());
+        nodes.reset();
     }
-    for (int i = 0; i < (int)unmarked.size(); ++i)
+
+    TreeNode *newNode(char op, TreeNode *left, TreeNode *right = nullptr)
     {
-        dfa.isAccept[i] = (unmarked[i].count(hashPos) > 0);
+        TreeNode *node = nodes.make(op);
+        node->id = ++idCounter;
+        node->left = left;
+        node->right = right;
+        return node;
     }
-    dfa.sets = unmarked;
-    return dfa;
-}
 
-// Clean up memory
-void releaseAll()
-{
-    for (auto ptr : nodesPool)
-        delete ptr;
-    nodesPool.clear();
-}
+    TreeNode *newLeaf(const bitset<256> &bytes, const string &label, int rule = -1)
+    {
+        TreeNode *leaf = nodes.make('\0'); // shown by its positionLabel
+        leaf->id = ++idCounter;
+        leaf->position = ++posCounter;
+        positionBytes.push_back(bytes);
+        positionLabel.push_back(label);
+        positionRule.push_back(rule);
+        nextPositions.emplace_back();
+        return leaf;
+    }
 
-// Run a test scenario
-void runTest(const string &name, const string &expr)
-{
-    cout << "\n"
-         << string(60, '=') << "\n";
-    cout << "TEST CASE: " << name << "\n";
-    cout << "Regular Expression: " << expr << "\n";
-    cout << string(60, '=') << "\n\n";
+    // Copy of a subtree with fresh positions, rebuilt from its post-order
+    // the way constructSyntaxTree builds from postfix
+    TreeNode *cloneTree(TreeNode *node)
+    {
+        vector<TreeNode *> copies;
+        for (TreeNode *n : postOrder(node))
+        {
+            if (n->position)
+            {
+                copies.push_back(newLeaf(positionBytes[n->position], positionLabel[n->position], positionRule[n->position]));
+                continue;
+            }
+            TreeNode *right = n->right ? copies.back() : nullptr;
+            if (right)
+                copies.pop_back();
+            TreeNode *left = copies.back();
+            copies.pop_back();
+            copies.push_back(newNode(n->value, left, right));
+        }
+        return copies.back();
+    }
+
+    // x{lo,hi}: lo copies of x, then x* when unbounded, or nested optional
+    // copies (x(x(x)?)?)? for the remaining hi - lo
+    TreeNode *repeatTree(TreeNode *x, int lo, int hi)
+    {
+        TreeNode *result = nullptr;
+        auto append = [&](TreeNode *part)
+        { result = result ? newNode('.', result, part) : part; };
+        bool used = false;
+        auto copy = [&]()
+        {
+            TreeNode *c = used ? cloneTree(x) : x;
+            used = true;
+            return c;
+        };
+        for (int i = 0; i < lo; ++i)
+            append(copy());
+        if (hi < 0)
+            append(newNode('*', copy()));
+        else if (hi > lo)
+        {
+            vector<TreeNode *> copies;
+            for (int i = lo; i < hi; ++i)
+                copies.push_back(copy());
+            TreeNode *optional = newNode('?', copies.back());
+            for (int i = (int)copies.size() - 2; i >= 0; --i)
+                optional = newNode('?', newNode('.', copies[i], optional));
+            append(optional);
+        }
+        return result;
+    }
 
-    posCounter = 0;
-    idCounter = 0;
-    positionSymbol.clear();
-    nextPositions.clear();
-    releaseAll();
+    // Build syntax tree from postfix regex
+    TreeNode *constructSyntaxTree(const vector<RegexToken> &postfix)
+    {
+        stack<TreeNode *> st;
+        auto pop = [&]()
+        {
+            if (st.empty())
+                throw runtime_error("operator without operand in regex");
+            TreeNode *top = st.top();
+            st.pop();
+            return top;
+        };
+        for (const RegexToken &tok : postfix)
+        {
+            if (tok.op == '{')
+            {
+                st.push(repeatTree(pop(), tok.lo, tok.hi));
+            }
+            else if (isPostfixOp(tok.op))
+            {
+                st.push(newNode(tok.op, pop()));
+            }
+            else if (tok.op)
+            {
+                TreeNode *right = pop();
+                TreeNode *left = pop();
+                st.push(newNode(tok.op, left, right));
+            }
+            else
+            {
+                st.push(newLeaf(tok.bytes, tok.text, tok.bytes.none() ? 0 : -1));
+            }
+        }
+        if (st.size() != 1)
+            throw runtime_error("malformed regex");
+        return st.top();
+    }
 
-    string withConcat = insertConcatOperators(expr);
-    cout << "Regex with explicit concatenation: " << withConcat << "\n";
-    string post = infixToPostfix(withConcat);
-    cout << "Postfix regex: " << post << "\n\n";
+    // Compute nullable, firstPos, lastPos and followpos (nextPositions) in
+    // one sweep over the nodes in post-order. A node's followpos edges need
+    // only its children's sets, so unless keepSets those are handed to the
+    // parent or dropped once it is done; only the root keeps its sets.
+    void analyzeTree(TreeNode *root, bool keepSets = false)
+    {
+        auto take = [&](PosSet &s)
+        { return keepSets ? PosSet(s) : move(s); };
+        for (TreeNode *node : postOrder(root))
+        {
+            TreeNode *l = node->left, *r = node->right;
+            if (!l)
+            {
+                node->isNullable = false;
+                node->startPos = singleton(node->position);
+                node->endPos = node->startPos;
+                continue;
+            }
+            if (node->value == '|')
+            {
+                node->isNullable = l->isNullable || r->isNullable;
+                node->startPos = take(l->startPos);
+                node->startPos.unite(r->startPos);
+                node->endPos = take(l->endPos);
+                node->endPos.unite(r->endPos);
+            }
+            else if (node->value == '.')
+            {
+                l->endPos.forEach([&](int p)
+                                  { nextPositions[p].unite(r->startPos); });
+                node->isNullable = l->isNullable && r->isNullable;
+                node->startPos = take(l->startPos);
+                if (l->isNullable)
+                    node->startPos.unite(r->startPos);
+                node->endPos = take(r->endPos);
+                if (r->isNullable)
+                    node->endPos.unite(l->endPos);
+            }
+            else
+            {
+                node->isNullable = node->value != '+' || l->isNullable;
+                node->startPos = take(l->startPos);
+                node->endPos = take(l->endPos);
+                if (node->value != '?')
+                    node->endPos.forEach([&](int p)
+                                         { nextPositions[p].unite(node->startPos); });
+            }
+            if (!keepSets)
+            {
+                l->startPos = l->endPos = PosSet();
+                if (r)
+                    r->startPos = r->endPos = PosSet();
+            }
+        }
+    }
 
-    TreeNode *root = constructSyntaxTree(post);
-    analyzeTree(root);
-    buildNextPositions(root);
+    // Tokenize, make concatenation explicit and build the syntax tree. One
+    // token list is alive at a time, which matters for very long regexes.
+    TreeNode *parseRegex(const string &expr)
+    {
+        vector<RegexToken> tokens = tokenizeRegex(expr);
+        tokens = insertConcatOperators(tokens);
+        tokens = infixToPostfix(tokens);
+        return constructSyntaxTree(tokens);
+    }
 
-    cout << "FIRSTPOS AND LASTPOS FOR ALL NODES:\n";
-    cout << string(40, '-') << "\n";
-    displayNodeDetails(root);
+    // Fresh syntax tree for expr with nullable, firstpos, lastpos and
+    // followpos filled in
+    TreeNode *analyzeRegex(const string &expr)
+    {
+        reset();
+        TreeNode *root = parseRegex(expr);
+        analyzeTree(root);
+        return root;
+    }
 
-    cout << "\nFOLLOWPOS TABLE:\n";
-    cout << string(40, '-') << "\n";
-    for (int i = 1; i <= posCounter; ++i)
+    // Display node details, parents before children, from an explicit
+    // stack of (node, depth)
+    void displayNodeDetails(TreeNode *root) const
     {
-        cout << "Position " << i << " (" << positionSymbol[i] << ") : "
-             << showSet(nextPositions[i]) << "\n";
+        vector<pair<TreeNode *, int>> pending;
+        if (root)
+            pending.push_back({root, 0});
+        while (!pending.empty())
+        {
+            auto [node, lvl] = pending.back();
+            pending.pop_back();
+            string pad(lvl * 2, ' ');
+            cout << pad << "Node " << node->id << " ("
+                 << (node->position ? positionLabel[node->position] : string(1, node->value)) << ")";
+            if (node->position)
+                cout << " [pos=" << node->position << "]";
+            cout << ":\n";
+            cout << pad << " nullable: " << (node->isNullable ? "true" : "false") << "\n";
+            cout << pad << " firstpos: " << showSet(node->startPos) << "\n";
+            cout << pad << " lastpos: " << showSet(node->endPos) << "\n";
+            if (node->right)
+                pending.push_back({node->right, lvl + 1});
+            if (node->left)
+                pending.push_back({node->left, lvl + 1});
+        }
     }
 
-    auto dfa = buildDFA(root);
-    cout << "\nDFA STATES AND TRANSITIONS:\n";
-    cout << string(40, '-') << "\n";
-    for (int i = 0; i < (int)dfa.sets.size(); ++i)
+    // Split the 256 bytes into classes that no leaf's byte-set separates.
+    // Class 0 holds the bytes no leaf reads (if any); the rest are numbered
+    // by their lowest byte. classList[p] lists the classes position p reads.
+    int computeByteClasses(array<uint8_t, 256> &classOf, vector<vector<int>> &classList) const
     {
-        cout << "State " << char('A' + i) << " : "
-             << showSet(dfa.sets[i]);
-        if (dfa.isAccept[i])
-            cout << " [Accepting]";
-        if (i == dfa.start)
-            cout << " [Start]";
-        cout << "\n";
+        unordered_map<bitset<256>, int> distinct;
+        vector<const bitset<256> *> sets;
+        for (size_t p = 1; p < positionBytes.size(); ++p)
+            if (positionBytes[p].any() && distinct.emplace(positionBytes[p], (int)sets.size()).second)
+                sets.push_back(&positionBytes[p]);
+
+        // Refine one set at a time: a byte's signature is its old class plus
+        // whether the set contains it
+        array<int, 256> sig{};
+        int count = 1;
+        bitset<256> read;
+        vector<int> remap;
+        for (const bitset<256> *s : sets)
+        {
+            read |= *s;
+            remap.assign(2 * count, -1);
+            int next = 0;
+            for (int b = 0; b < 256; ++b)
+            {
+                int &id = remap[2 * sig[b] + (*s)[b]];
+                if (id < 0)
+                    id = next++;
+                sig[b] = id;
+            }
+            count = next;
+        }
+
+        vector<int> number(count, -1);
+        int numClasses = 0;
+        for (int b = 0; b < 256 && numClasses == 0; ++b)
+            if (!read[b])
+                number[sig[b]] = numClasses++;
+        for (int b = 0; b < 256; ++b)
+        {
+            if (number[sig[b]] < 0)
+                number[sig[b]] = numClasses++;
+            classOf[b] = (uint8_t)number[sig[b]];
+        }
+
+        vector<vector<int>> perSet(sets.size());
+        for (size_t i = 0; i < sets.size(); ++i)
+        {
+            for (int b = 0; b < 256; ++b)
+                if ((*sets[i])[b])
+                    perSet[i].push_back(classOf[b]);
+            sort(perSet[i].begin(), perSet[i].end());
+            perSet[i].erase(unique(perSet[i].begin(), perSet[i].end()), perSet[i].end());
+        }
+        classList.assign(positionBytes.size(), {});
+        for (size_t p = 1; p < positionBytes.size(); ++p)
+            if (positionBytes[p].any())
+                classList[p] = perSet[distinct[positionBytes[p]]];
+        return numClasses;
     }
 
-    cout << "\nTRANSITION TABLE:\n";
-    cout << string(40, '-') << "\n";
-    cout << "State\t|\ta\t|\tb\n";
-    cout << string(40, '-') << "\n";
-    for (int i = 0; i < (int)dfa.sets.size(); ++i)
+    // Construct DFA. An unanchored DFA adds firstpos of the root to every
+    // state, so a match may begin at any byte; it is what search() runs.
+    DFAState buildDFA(TreeNode *root, bool unanchored = false) const
     {
-        cout << char('A' + i) << "\t|\t";
-        auto itA = dfa.transitions.find({i, 'a'});
-        cout << (itA != dfa.transitions.end() ? char('A' + itA->second) : '-') << "\t|\t";
-        auto itB = dfa.transitions.find({i, 'b'});
-        cout << (itB != dfa.transitions.end() ? char('A' + itB->second) : '-') << "\n";
+        DFAState dfa;
+        StateTable states;
+        bool inserted;
+
+        vector<vector<int>> classList;
+        dfa.numClasses = computeByteClasses(dfa.classOf, classList);
+        size_t k = dfa.numClasses;
+
+        states.intern(PosSet(root->startPos), inserted);
+        dfa.start = 0;
+
+        vector<PosSet> moves(k);
+        vector<char> hit(k, 0);
+        vector<int> touched;
+        for (size_t idx = 0; idx < states.sets.size(); ++idx)
+        {
+            touched.clear();
+            states.sets[idx].forEach([&](int p)
+                                     {
+                for (int c : classList[p])
+                {
+                    if (!hit[c])
+                    {
+                        hit[c] = 1;
+                        touched.push_back(c);
+                    }
+                    moves[c].unite(nextPositions[p]);
+                } });
+            if (unanchored)
+            {
+                touched.clear();
+                for (size_t c = 0; c < k; ++c)
+                {
+                    hit[c] = 1;
+                    touched.push_back((int)c);
+                    moves[c].unite(root->startPos);
+                }
+            }
+            sort(touched.begin(), touched.end());
+
+            dfa.transitions.resize((idx + 1) * k, DFAState::DEAD);
+            for (int c : touched)
+            {
+                hit[c] = 0;
+                if (!moves[c].empty())
+                    dfa.transitions[idx * k + c] = states.intern(move(moves[c]), inserted);
+                moves[c] = PosSet();
+            }
+        }
+        vector<PosSet> &unmarked = states.sets;
+
+        vector<int> endMarkers;
+        for (int p = 1; p < (int)positionBytes.size(); ++p)
+        {
+            if (positionRule[p] >= 0)
+                endMarkers.push_back(p);
+        }
+        dfa.isAccept.resize(unmarked.size());
+        dfa.acceptRule.assign(unmarked.size(), -1);
+        for (int i = 0; i < (int)unmarked.size(); ++i)
+        {
+            for (int p : endMarkers)
+            {
+                int rule = positionRule[p];
+                if (unmarked[i].contains(p) && (dfa.acceptRule[i] < 0 || rule < dfa.acceptRule[i]))
+                    dfa.acceptRule[i] = rule;
+            }
+            dfa.isAccept[i] = dfa.acceptRule[i] >= 0;
+        }
+        dfa.sets = move(unmarked);
+        return dfa;
+    }
+
+    // Parse expr and build its DFA
+    DFAState compile(const string &expr, bool unanchored = false)
+    {
+        return buildDFA(analyzeRegex(expr), unanchored);
+    }
+};
+
+
+// Hopcroft partition refinement in O(n k log n). Missing transitions go
+// to an implicit dead state, and states equivalent to it are dropped.
+// Minimized states are numbered by their lowest original state, so the
+// start state stays first; blockOf maps each original state to its
+// minimized state, or -1 if it was dropped.
+DFAState minimizeDFA(const DFAState &dfa, vector<int> &blockOf)
+{
+    int n = (int)dfa.sets.size();
+    int total = n + 1, dead = n;
+
+    int k = dfa.numClasses;
+    vector<int> delta((size_t)total * k, dead);
+    for (size_t i = 0; i < dfa.transitions.size(); ++i)
+        if (dfa.transitions[i] != DFAState::DEAD)
+            delta[i] = (int)dfa.transitions[i];
+
+    // Predecessors of (state, symbol), grouped by target
+    vector<int> invStart((size_t)total * k + 1, 0), inv((size_t)total * k);
+    for (size_t i = 0; i < delta.size(); ++i)
+        ++invStart[(size_t)delta[i] * k + i % k + 1];
+    for (size_t i = 1; i < invStart.size(); ++i)
+        invStart[i] += invStart[i - 1];
+    {
+        vector<int> fill(invStart.begin(), invStart.end() - 1);
+        for (size_t i = 0; i < delta.size(); ++i)
+            inv[fill[(size_t)delta[i] * k + i % k]++] = int(i / k);
+    }
+
+    // Blocks are ranges of elems; each block keeps its marked states in front
+    vector<int> elems, loc(total), block(total);
+    vector<int> bStart, bEnd, bMarked;
+    auto addBlock = [&](int s, int e)
+    {
+        bStart.push_back(s);
+        bEnd.push_back(e);
+        bMarked.push_back(0);
+        for (int i = s; i < e; ++i)
+            block[elems[i]] = (int)bStart.size() - 1;
+        return (int)bStart.size() - 1;
+    };
+    // Start with one block per accepted rule and one for the rest
+    auto ruleOf = [&](int s)
+    { return s == dead ? -1 : dfa.acceptRule[s]; };
+    for (int s = 0; s < total; ++s)
+        elems.push_back(s);
+    stable_sort(elems.begin(), elems.end(), [&](int a, int b)
+                { return ruleOf(a) < ruleOf(b); });
+    for (int i = 0; i < total; ++i)
+        loc[elems[i]] = i;
+    for (int i = 0, j; i < total; i = j)
+    {
+        for (j = i; j < total && ruleOf(elems[j]) == ruleOf(elems[i]); ++j)
+            ;
+        addBlock(i, j);
+    }
+
+    vector<char> inWork;
+    vector<pair<int, int>> work;
+    auto push = [&](int b, int c)
+    {
+        if (inWork.size() < (size_t)(b + 1) * k)
+            inWork.resize((size_t)(b + 1) * k, 0);
+        if (!inWork[(size_t)b * k + c])
+        {
+            inWork[(size_t)b * k + c] = 1;
+            work.push_back({b, c});
+        }
+    };
+    // Every initial block but the largest splits the others
+    int largest = 0;
+    for (int b = 1; b < (int)bStart.size(); ++b)
+        if (bEnd[b] - bStart[b] > bEnd[largest] - bStart[largest])
+            largest = b;
+    for (int b = 0; b < (int)bStart.size(); ++b)
+        if (b != largest)
+            for (int c = 0; c < k; ++c)
+                push(b, c);
+
+    vector<int> preimage, touched;
+    while (!work.empty())
+    {
+        int a = work.back().first, c = work.back().second;
+        work.pop_back();
+        inWork[(size_t)a * k + c] = 0;
+
+        preimage.clear();
+        for (int i = bStart[a]; i < bEnd[a]; ++i)
+        {
+            size_t key = (size_t)elems[i] * k + c;
+            preimage.insert(preimage.end(), inv.begin() + invStart[key], inv.begin() + invStart[key + 1]);
+        }
+
+        // Each state has one successor on c, so preimage has no duplicates
+        touched.clear();
+        for (int s : preimage)
+        {
+            int b = block[s];
+            int front = bStart[b] + bMarked[b];
+            int other = elems[front];
+            swap(elems[loc[s]], elems[front]);
+            loc[other] = loc[s];
+            loc[s] = front;
+            if (bMarked[b]++ == 0)
+                touched.push_back(b);
+        }
+
+        for (int b : touched)
+        {
+            int marked = bMarked[b];
+            bMarked[b] = 0;
+            int size = bEnd[b] - bStart[b];
+            if (marked == size)
+                continue;
+            // The new block is always the smaller half
+            int nb;
+            if (marked <= size - marked)
+            {
+                bStart[b] += marked;
+                nb = addBlock(bStart[b] - marked, bStart[b]);
+            }
+            else
+            {
+                bEnd[b] = bStart[b] + marked;
+                nb = addBlock(bEnd[b], bEnd[b] + size - marked);
+            }
+            for (int c2 = 0; c2 < k; ++c2)
+                push(nb, c2);
+        }
+    }
+
+    DFAState result;
+    result.classOf = dfa.classOf;
+    result.numClasses = k;
+    int deadBlock = block[dead];
+    vector<int> newId(bStart.size(), -1), rep;
+    for (int s = 0; s < n; ++s)
+    {
+        int b = block[s];
+        if (b != deadBlock && newId[b] < 0)
+        {
+            newId[b] = (int)rep.size();
+            rep.push_back(s);
+        }
+    }
+    blockOf.assign(n, -1);
+    result.sets.resize(rep.size());
+    result.isAccept.resize(rep.size());
+    result.acceptRule.resize(rep.size());
+    result.transitions.assign(rep.size() * k, DFAState::DEAD);
+    for (int s = 0; s < n; ++s)
+    {
+        if (block[s] == deadBlock)
+            continue;
+        blockOf[s] = newId[block[s]];
+        result.sets[blockOf[s]].unite(dfa.sets[s]);
+    }
+    for (int i = 0; i < (int)rep.size(); ++i)
+    {
+        result.isAccept[i] = dfa.isAccept[rep[i]];
+        result.acceptRule[i] = dfa.acceptRule[rep[i]];
+        for (int c = 0; c < k; ++c)
+        {
+            int t = delta[(size_t)rep[i] * k + c];
+            if (block[t] != deadBlock)
+                result.transitions[(size_t)i * k + c] = newId[block[t]];
+        }
+    }
+    result.start = blockOf[dfa.start];
+    return result;
+}
+
+// True when all of text is in the language
+bool match(const DFATable &dfa, const char *text, size_t n)
+{
+    if (dfa.start < 0)
+        return false;
+    const uint32_t *table = dfa.transitions;
+    const uint8_t *classOf = dfa.classOf;
+    size_t k = dfa.numClasses;
+    uint32_t s = dfa.start;
+    for (size_t i = 0; i < n; ++i)
+    {
+        s = table[s * k + classOf[(unsigned char)text[i]]];
+        if (s == DFAState::DEAD)
+            return false;
+    }
+    return dfa.isAccept[s];
+}
+
+bool match(const DFATable &dfa, const string &s)
+{
+    return match(dfa, s.data(), s.size());
+}
+
+// Offset just past the earliest-ending match in text, or -1. On an
+// unanchored DFA the match may start anywhere; on an anchored one this
+// finds the shortest matching prefix.
+long search(const DFATable &dfa, const char *text, size_t n)
+{
+    if (dfa.start < 0)
+        return -1;
+    const uint32_t *table = dfa.transitions;
+    const uint8_t *classOf = dfa.classOf;
+    const uint8_t *accept = dfa.isAccept;
+    size_t k = dfa.numClasses;
+    uint32_t s = dfa.start;
+    if (accept[s])
+        return 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        s = table[s * k + classOf[(unsigned char)text[i]]];
+        if (s == DFAState::DEAD)
+            return -1;
+        if (accept[s])
+            return (long)i + 1;
+    }
+    return -1;
+}
+
+// DFA file, version DFA_FILE_VERSION: this header, then the transition
+// table (uint32 per state and class), acceptRule (int32 per state), the
+// 256-byte class map and isAccept (one byte per state), each at the offset
+// the header gives, in the byte order of the machine that wrote it.
+// Offsets are 8-byte aligned so a mapping of the file is used in place.
+static const char DFA_FILE_MAGIC[8] = {'L', 'A', 'B', '4', 'D', 'F', 'A', '\n'};
+static const uint32_t DFA_FILE_VERSION = 2;
+static const uint32_t DFA_BYTE_ORDER = 0x01020304;
+
+struct DFAFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // DFA_BYTE_ORDER as the writer stored it
+    uint32_t numStates;
+    uint32_t numClasses;
+    int32_t start;     // -1 for a DFA that matches nothing
+    uint32_t numRules; // acceptRule values are -1 or below this
+    uint64_t transitionsOffset;
+    uint64_t acceptRuleOffset;
+    uint64_t classOfOffset;
+    uint64_t isAcceptOffset;
+    uint64_t fileSize;
+};
+
+// Write dfa, whose acceptRule values are below numRules, as a DFA file
+void saveDFA(const DFAState &dfa, uint32_t numRules, const string &filename)
+{
+    static_assert(sizeof(int) == sizeof(int32_t), "acceptRule is written as int32");
+    auto align = [](uint64_t offset)
+    { return (offset + 7) & ~uint64_t(7); };
+    DFAFileHeader h{};
+    memcpy(h.magic, DFA_FILE_MAGIC, sizeof h.magic);
+    h.version = DFA_FILE_VERSION;
+    h.byteOrder = DFA_BYTE_ORDER;
+    h.numStates = (uint32_t)dfa.isAccept.size();
+    h.numClasses = (uint32_t)dfa.numClasses;
+    h.start = dfa.start;
+    h.numRules = numRules;
+    h.transitionsOffset = align(sizeof h);
+    h.acceptRuleOffset = align(h.transitionsOffset + dfa.transitions.size() * sizeof(uint32_t));
+    h.classOfOffset = align(h.acceptRuleOffset + dfa.acceptRule.size() * sizeof(int32_t));
+    h.isAcceptOffset = h.classOfOffset + dfa.classOf.size();
+    h.fileSize = h.isAcceptOffset + dfa.isAccept.size();
+
+    ofstream out(filename, ios::binary);
+    if (!out)
+        throw runtime_error("cannot write '" + filename + "'");
+    auto section = [&](uint64_t offset, const void *data, size_t bytes)
+    {
+        static const char zeros[8] = {};
+        out.write(zeros, offset - (uint64_t)out.tellp());
+        out.write(static_cast<const char *>(data), bytes);
+    };
+    out.write(reinterpret_cast<const char *>(&h), sizeof h);
+    section(h.transitionsOffset, dfa.transitions.data(), dfa.transitions.size() * sizeof(uint32_t));
+    section(h.acceptRuleOffset, dfa.acceptRule.data(), dfa.acceptRule.size() * sizeof(int32_t));
+    section(h.classOfOffset, dfa.classOf.data(), dfa.classOf.size());
+    section(h.isAcceptOffset, dfa.isAccept.data(), dfa.isAccept.size());
+    if (!out.flush())
+        throw runtime_error("cannot write '" + filename + "'");
+}
+
+// A DFA file mapped read-only. The header is checked, then the start state
+// and every transition, class and accepting rule once, so a bad file cannot
+// make a match or a lexer read out of bounds; table() points straight
+// into the mapping.
+class MappedDFA
+{
+    void *addr = MAP_FAILED;
+    size_t size = 0;
+    uint32_t rules = 0;
+    DFATable view;
+
+    // Why the arrays of a file whose header checked out are unusable, or
+    // nullptr: transitions must be states or DEAD, class map bytes
+    // classes, and acceptRule -1 or a rule, with isAccept set exactly
+    // where it is a rule
+    static const char *checkContents(const char *base, const DFAFileHeader &h)
+    {
+        uint64_t n = h.numStates;
+        const uint32_t *transitions = reinterpret_cast<const uint32_t *>(base + h.transitionsOffset);
+        for (uint64_t i = 0; i < n * h.numClasses; ++i)
+            if (transitions[i] >= n && transitions[i] != DFAState::DEAD)
+                return "DFA file has a transition out of range";
+        const uint8_t *classOf = reinterpret_cast<const uint8_t *>(base + h.classOfOffset);
+        for (int b = 0; b < 256; ++b)
+            if (classOf[b] >= h.numClasses)
+                return "DFA file has a byte class out of range";
+        const int32_t *acceptRule = reinterpret_cast<const int32_t *>(base + h.acceptRuleOffset);
+        const uint8_t *isAccept = reinterpret_cast<const uint8_t *>(base + h.isAcceptOffset);
+        for (uint64_t s = 0; s < n; ++s)
+        {
+            if (acceptRule[s] < -1 || (acceptRule[s] >= 0 && (uint32_t)acceptRule[s] >= h.numRules))
+                return "DFA file has an accepting rule out of range";
+            if (isAccept[s] != (acceptRule[s] >= 0))
+                return "DFA file has isAccept and acceptRule disagreeing";
+        }
+        return nullptr;
+    }
+
+public:
+    explicit MappedDFA(const string &filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw runtime_error("cannot open DFA file '" + filename + "'");
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(DFAFileHeader))
+        {
+            size = (size_t)st.st_size;
+            addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (addr == MAP_FAILED)
+            throw runtime_error("'" + filename + "' is not a DFA file");
+
+        const char *base = static_cast<const char *>(addr);
+        const DFAFileHeader &h = *reinterpret_cast<const DFAFileHeader *>(base);
+        const char *problem = nullptr;
+        uint64_t n = h.numStates, tableBytes = n * h.numClasses * sizeof(uint32_t);
+        // offset .. offset + bytes lies past the header and inside the file
+        auto fits = [&](uint64_t offset, uint64_t bytes)
+        { return offset >= sizeof(DFAFileHeader) && offset <= size && bytes <= size - offset; };
+        if (memcmp(h.magic, DFA_FILE_MAGIC, sizeof h.magic) != 0)
+            problem = "not a DFA file";
+        else if (h.version != DFA_FILE_VERSION)
+            problem = "unsupported DFA file version";
+        else if (h.byteOrder != DFA_BYTE_ORDER)
+            problem = "DFA file was written with another byte order";
+        else if (h.fileSize != size || h.numClasses < 1 || h.numClasses > 256 || h.start < -1 ||
+                 h.start >= (int64_t)n || h.transitionsOffset % 8 || h.acceptRuleOffset % 8 ||
+                 !fits(h.transitionsOffset, tableBytes) || !fits(h.acceptRuleOffset, n * sizeof(int32_t)) ||
+                 !fits(h.classOfOffset, 256) || !fits(h.isAcceptOffset, n) ||
+                 h.transitionsOffset + tableBytes > h.acceptRuleOffset ||
+                 h.acceptRuleOffset + n * sizeof(int32_t) > h.classOfOffset ||
+                 h.classOfOffset + 256 > h.isAcceptOffset)
+            problem = "DFA file is truncated or corrupt";
+        else
+            problem = checkContents(base, h);
+        if (problem)
+        {
+            munmap(addr, size);
+            throw runtime_error("'" + filename + "': " + problem);
+        }
+        view.transitions = reinterpret_cast<const uint32_t *>(base + h.transitionsOffset);
+        view.acceptRule = reinterpret_cast<const int *>(base + h.acceptRuleOffset);
+        view.classOf = reinterpret_cast<const uint8_t *>(base + h.classOfOffset);
+        view.isAccept = reinterpret_cast<const uint8_t *>(base + h.isAcceptOffset);
+        view.numStates = h.numStates;
+        view.numClasses = h.numClasses;
+        view.start = h.start;
+        rules = h.numRules;
+    }
+
+    ~MappedDFA() { munmap(addr, size); }
+
+    MappedDFA(const MappedDFA &) = delete;
+    MappedDFA &operator=(const MappedDFA &) = delete;
+
+    const DFATable &table() const { return view; }
+    uint32_t numRules() const { return rules; }
+};
+
+// DFA built while matching: a state is interned the first time a move
+// reaches it and its row of transitions fills in as moves are taken. At
+// most maxStates states are cached; a full cache is flushed and refilled
+// from the current state. If the cache has run fewer than 10 bytes per
+// state since the last flush it is thrashing: it is kept, and the next
+// 10 bytes per state are run by stepping position sets directly before the
+// cache is flushed and refilled from where simulation stopped.
+class LazyDFA
+{
+public:
+    struct Counters
+    {
+        uint64_t hits = 0;           // moves found in the cache
+        uint64_t misses = 0;         // moves computed from position sets
+        uint64_t flushes = 0;        // times the full cache was emptied
+        uint64_t simulatedBytes = 0; // bytes stepped without the cache
+    };
+
+    // Takes followpos and the leaves of the compiler's current syntax tree
+    LazyDFA(const RegexCompiler &compiler, TreeNode *root, size_t maxStates, bool unanchored = false)
+        : follow(compiler.nextPositions), bytes(compiler.positionBytes), startSet(root->startPos),
+          unanchored(unanchored), maxStates(max<size_t>(maxStates, 2))
+    {
+        vector<vector<int>> classList;
+        k = compiler.computeByteClasses(classOf, classList);
+        for (int p = 1; p < (int)compiler.positionRule.size(); ++p)
+            if (compiler.positionRule[p] >= 0)
+                endSet.insert(p);
+    }
+
+    // True when all of text is in the language
+    bool match(const char *text, size_t n)
+    {
+        bool accepted;
+        run(text, n, false, accepted);
+        return accepted;
+    }
+
+    // Offset just past the earliest-ending match, or -1, as search() does
+    long search(const char *text, size_t n)
+    {
+        bool accepted;
+        return run(text, n, true, accepted);
+    }
+
+    const Counters &counters() const { return stats; }
+    size_t cachedStates() const { return cache.sets.size(); }
+
+private:
+    static constexpr uint32_t UNKNOWN = DFAState::DEAD - 1;
+
+    vector<PosSet> follow;
+    vector<bitset<256>> bytes;
+    PosSet startSet, endSet;
+    array<uint8_t, 256> classOf{};
+    size_t k = 1;
+    bool unanchored;
+    size_t maxStates;
+
+    StateTable cache;
+    vector<uint32_t> transitions; // [state * k + class], UNKNOWN until taken
+    vector<uint8_t> accept;
+    uint32_t startState = UNKNOWN;
+    uint64_t bytesSinceFlush = 0;
+    Counters stats;
+
+    // to = the positions reached from `from` on byte b
+    void step(const PosSet &from, unsigned char b, PosSet &to) const
+    {
+        to.clear();
+        from.forEach([&](int p)
+                     {
+            if (bytes[p][b])
+                to.unite(follow[p]); });
+        if (unanchored)
+            to.unite(startSet);
+    }
+
+    uint32_t addState(PosSet &&set)
+    {
+        bool inserted;
+        uint32_t id = cache.intern(move(set), inserted);
+        if (inserted)
+        {
+            transitions.resize(cache.sets.size() * k, UNKNOWN);
+            accept.push_back(cache.sets[id].intersects(endSet));
+        }
+        return id;
+    }
+
+    void flush()
+    {
+        ++stats.flushes;
+        cache.clear();
+        transitions.clear();
+        accept.clear();
+        startState = UNKNOWN;
+        bytesSinceFlush = 0;
+    }
+
+    // Run text from the start state. Returns the offset past the first
+    // accepting state when stopAtAccept, else -1; accepted tells whether
+    // the run ended in an accepting state.
+    long run(const char *text, size_t n, bool stopAtAccept, bool &accepted)
+    {
+        accepted = false;
+        if (startState == UNKNOWN)
+            startState = addState(PosSet(startSet));
+        uint32_t s = startState;
+        if (stopAtAccept && accept[s])
+            return accepted = true, 0;
+
+        bool simulating = false;
+        uint64_t simulated = 0;
+        PosSet current, next;
+        for (size_t i = 0; i < n; ++i)
+        {
+            unsigned char b = text[i];
+            bool acc;
+            if (simulating)
+            {
+                ++stats.simulatedBytes;
+                step(current, b, next);
+                swap(current, next);
+                if (current.empty())
+                    return -1;
+                if (++simulated < 10 * maxStates)
+                {
+                    acc = current.intersects(endSet);
+                }
+                else
+                {
+                    flush();
+                    s = addState(move(current));
+                    simulating = false;
+                    acc = accept[s];
+                }
+            }
+            else
+            {
+                ++bytesSinceFlush;
+                size_t slot = s * k + classOf[b];
+                uint32_t next = transitions[slot];
+                if (next < UNKNOWN)
+                {
+                    ++stats.hits;
+                    s = next;
+                }
+                else if (next == DFAState::DEAD)
+                {
+                    ++stats.hits;
+                    return -1;
+                }
+                else
+                {
+                    ++stats.misses;
+                    PosSet target;
+                    step(cache.sets[s], b, target);
+                    if (target.empty())
+                    {
+                        transitions[slot] = DFAState::DEAD;
+                        return -1;
+                    }
+                    int known = cache.find(target);
+                    if (known >= 0)
+                    {
+                        transitions[slot] = known;
+                        s = known;
+                    }
+                    else if (cache.sets.size() >= maxStates)
+                    {
+                        if (bytesSinceFlush < 10 * maxStates)
+                        {
+                            simulating = true;
+                            simulated = 1;
+                            current = move(target);
+                            ++stats.simulatedBytes;
+                            acc = current.intersects(endSet);
+                            if (stopAtAccept && acc)
+                                return accepted = true, (long)i + 1;
+                            continue;
+                        }
+                        flush();
+                        s = addState(move(target));
+                    }
+                    else
+                    {
+                        uint32_t id = addState(move(target));
+                        transitions[slot] = id;
+                        s = id;
+                    }
+                }
+                acc = accept[s];
+            }
+            if (stopAtAccept && acc)
+                return accepted = true, (long)i + 1;
+        }
+        accepted = simulating ? current.intersects(endSet) : accept[s];
+        return -1;
+    }
+};
+
+// Print the transitions on 'a' and 'b'
+void printTransitionTable(const DFAState &dfa)
+{
+    cout << string(40, '-') << "\n";
+    cout << "State\t|\ta\t|\tb\n";
+    cout << string(40, '-') << "\n";
+    for (int i = 0; i < (int)dfa.sets.size(); ++i)
+    {
+        cout << char('A' + i) << "\t|\t";
+        uint32_t onA = dfa.next(i, 'a');
+        cout << (onA != DFAState::DEAD ? char('A' + onA) : '-') << "\t|\t";
+        uint32_t onB = dfa.next(i, 'b');
+        cout << (onB != DFAState::DEAD ? char('A' + onB) : '-') << "\n";
+    }
+    cout << "\n";
+}
+
+// Run a test scenario
+void runTest(const string &name, const string &expr)
+{
+    cout << "\n"
+         << string(60, '=') << "\n";
+    cout << "TEST CASE: " << name << "\n";
+    cout << "Regular Expression: " << expr << "\n";
+    cout << string(60, '=') << "\n\n";
+
+    RegexCompiler compiler;
+    auto withConcat = insertConcatOperators(tokenizeRegex(expr));
+    cout << "Regex with explicit concatenation: " << showRegex(withConcat) << "\n";
+    auto post = infixToPostfix(withConcat);
+    cout << "Postfix regex: " << showRegex(post) << "\n\n";
+
+    TreeNode *root = compiler.constructSyntaxTree(post);
+    compiler.analyzeTree(root, true);
+
+    cout << "FIRSTPOS AND LASTPOS FOR ALL NODES:\n";
+    cout << string(40, '-') << "\n";
+    compiler.displayNodeDetails(root);
+
+    cout << "\nFOLLOWPOS TABLE:\n";
+    cout << string(40, '-') << "\n";
+    for (int i = 1; i <= compiler.posCounter; ++i)
+    {
+        cout << "Position " << i << " (" << compiler.positionLabel[i] << ") : "
+             << showSet(compiler.nextPositions[i]) << "\n";
+    }
+
+    auto dfa = compiler.buildDFA(root);
+    cout << "\nDFA STATES AND TRANSITIONS:\n";
+    cout << string(40, '-') << "\n";
+    for (int i = 0; i < (int)dfa.sets.size(); ++i)
+    {
+        cout << "State " << char('A' + i) << " : "
+             << showSet(dfa.sets[i]);
+        if (dfa.isAccept[i])
+            cout << " [Accepting]";
+        if (i == dfa.start)
+            cout << " [Start]";
+        cout << "\n";
+    }
+
+    cout << "\nTRANSITION TABLE:\n";
+    printTransitionTable(dfa);
+
+    vector<int> blockOf;
+    auto minimized = minimizeDFA(dfa, blockOf);
+    cout << "\nMINIMIZED DFA (Hopcroft):\n";
+    cout << string(40, '-') << "\n";
+    cout << "States: " << dfa.sets.size() << " -> " << minimized.sets.size() << "\n";
+    for (int i = 0; i < (int)minimized.sets.size(); ++i)
+    {
+        cout << "State " << char('A' + i) << " : merges";
+        for (int s = 0; s < (int)blockOf.size(); ++s)
+            if (blockOf[s] == i)
+                cout << ' ' << char('A' + s);
+        if (minimized.isAccept[i])
+            cout << " [Accepting]";
+        if (i == minimized.start)
+            cout << " [Start]";
+        cout << "\n";
+    }
+    cout << "\nMINIMIZED TRANSITION TABLE:\n";
+    printTransitionTable(minimized);
+}
+
+// A lexer rule: text matching regex is a token of the given kind. Of the
+// rules matching the longest lexeme, the highest priority wins, then the
+// earliest rule. Tokens of kind "skip" are dropped.
+struct LexRule
+{
+    string kind;
+    int priority;
+    string regex;
+};
+
+// The token classes of the hand-written Lab3 lexer. Lab3 stops at an
+// unterminated comment or string; the last two skip rules match one from
+// its opening to the end of the file, so no tokens follow it either. They
+// only win there: a closed comment or string is one byte longer. Unlike
+// Lab3, no error is printed for it.
+const vector<LexRule> lab3Rules = {
+    {"skip", 2, R"([ \t-\r]+)"},
+    {"skip", 2, R"(//[^\n]*)"},
+    {"skip", 2, R"(/\*([^*]|\*+[^*/])*\*+/)"},
+    {"skip", 2, R"(/\*([^*]|\*+[^*/])*\**)"},
+    {"skip", 2, R"("[^"]*)"},
+    {"Keyword", 2, "int|float|char|double|bool|void|return|if|else|while|for|do|switch|case|break|"
+                   "continue|class|struct|public|private|protected|new|delete|this|const|static|"
+                   "using|namespace"},
+    {"Identifier", 1, R"([A-Za-z_][A-Za-z0-9_]*)"},
+    {"Integer", 1, R"([0-9]+)"},
+    {"Float", 1, R"([0-9]+\.[0-9]*)"},
+    {"Literal", 1, R"("[^"]*")"},
+    {"Operator", 1, R"([+\-*/%<>=!&|]{1,2})"},
+    {"Special Symbol", 1, R"([(){}\[\];,:.#])"},
+};
+
+// One rule per line: kind, priority, then the regex up to the end of the
+// line. A kind containing spaces is written in double quotes. Blank lines
+// and lines starting with // are skipped.
+vector<LexRule> loadRules(const string &filename)
+{
+    ifstream in(filename);
+    if (!in)
+        throw runtime_error("cannot open rules file '" + filename + "'");
+    vector<LexRule> rules;
+    string line;
+    for (int lineNo = 1; getline(in, line); ++lineNo)
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        size_t i = line.find_first_not_of(" \t");
+        if (i == string::npos || line.compare(i, 2, "//") == 0)
+            continue;
+        LexRule rule;
+        size_t kindEnd = line[i] == '"' ? line.find('"', i + 1) : line.find_first_of(" \t", i);
+        if (kindEnd == string::npos)
+            throw runtime_error(filename + ":" + to_string(lineNo) + ": expected kind, priority and regex");
+        rule.kind = line[i] == '"' ? line.substr(i + 1, kindEnd - i - 1) : line.substr(i, kindEnd - i);
+        istringstream rest(line.substr(kindEnd + (line[i] == '"')));
+        if (!(rest >> rule.priority))
+            throw runtime_error(filename + ":" + to_string(lineNo) + ": expected a priority after the kind");
+        rest >> ws;
+        getline(rest, rule.regex);
+        if (rule.regex.empty())
+            throw runtime_error(filename + ":" + to_string(lineNo) + ": missing regex");
+        rules.push_back(rule);
+    }
+    if (rules.empty())
+        throw runtime_error("no rules in '" + filename + "'");
+    return rules;
+}
+
+// Indexes of rules by precedence: highest priority first, then file order
+vector<int> ruleOrder(const vector<LexRule> &rules)
+{
+    vector<int> order(rules.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&](int a, int b)
+                { return rules[a].priority > rules[b].priority; });
+    return order;
+}
+
+// One followpos DFA for all rules: rule bodies are joined by '|' and each
+// ends in its own end marker. Rules are numbered by precedence, so a state
+// accepts the lowest numbered rule it holds; order[rank] is the index in
+// rules of that rank. The result is minimized.
+DFAState buildLexerDFA(const vector<LexRule> &rules, vector<int> &order)
+{
+    order = ruleOrder(rules);
+
+    RegexCompiler compiler;
+    TreeNode *root = nullptr;
+    vector<TreeNode *> bodies;
+    for (int rank = 0; rank < (int)rules.size(); ++rank)
+    {
+        const LexRule &rule = rules[order[rank]];
+        vector<RegexToken> tokens;
+        try
+        {
+            tokens = tokenizeRegex(rule.regex);
+            for (const RegexToken &tok : tokens)
+                if (!tok.op && tok.bytes.none())
+                    throw runtime_error("write a literal '#' as \\#");
+            bodies.push_back(compiler.constructSyntaxTree(infixToPostfix(insertConcatOperators(tokens))));
+        }
+        catch (const runtime_error &e)
+        {
+            throw runtime_error("rule " + rule.kind + " /" + rule.regex + "/: " + e.what());
+        }
+        TreeNode *marked = compiler.newNode('.', bodies.back(), compiler.newLeaf(bitset<256>(), "#" + to_string(rank), rank));
+        root = root ? compiler.newNode('|', root, marked) : marked;
+    }
+    if (!root)
+        throw runtime_error("no lexer rules");
+    compiler.analyzeTree(root);
+    for (int rank = 0; rank < (int)rules.size(); ++rank)
+        if (bodies[rank]->isNullable)
+            throw runtime_error("rule " + rules[order[rank]].kind + " /" + rules[order[rank]].regex + "/ matches the empty string");
+    DFAState dfa = compiler.buildDFA(root);
+    vector<int> blockOf;
+    return minimizeDFA(dfa, blockOf);
+}
+
+// Maximal munch: run the DFA from p until it dies and return the rule of
+// the last accepting state seen, or -1; length is that lexeme's length
+int longestMatch(const DFATable &dfa, const char *p, const char *end, size_t &length)
+{
+    const uint32_t *table = dfa.transitions;
+    const uint8_t *classOf = dfa.classOf;
+    const int *acceptRule = dfa.acceptRule;
+    size_t k = dfa.numClasses;
+    uint32_t s = dfa.start;
+    int rule = -1;
+    length = 0;
+    if (dfa.start < 0)
+        return rule;
+    for (const char *q = p; q < end;)
+    {
+        s = table[s * k + classOf[(unsigned char)*q++]];
+        if (s == DFAState::DEAD)
+            break;
+        if (acceptRule[s] >= 0)
+        {
+            rule = acceptRule[s];
+            length = q - p;
+        }
+    }
+    return rule;
+}
+
+// Print the tokens of text the way the Lab3 lexer does: a token that
+// spans lines reports the line it ends on
+void printTokens(const DFATable &dfa, const vector<LexRule> &rules, const vector<int> &order,
+                 const char *text, size_t n, ostream &out, ostream &err)
+{
+    const char *p = text, *end = text + n;
+    int line = 1;
+    while (p < end)
+    {
+        size_t length;
+        int rank = longestMatch(dfa, p, end, length);
+        if (rank < 0)
+        {
+            err << "Lexical Error: Unrecognized token '" << *p << "' at line " << line << "\n";
+            line += *p++ == '\n';
+            continue;
+        }
+        const LexRule &rule = rules[order[rank]];
+        line += (int)count(p, p + length, '\n');
+        if (rule.kind != "skip")
+            out << "Token: " << rule.kind << ", Lexeme: " << string_view(p, length) << ", Line: " << line << "\n";
+        p += length;
+    }
+}
+
+// Escape s for a C string literal
+static string cString(const string &s)
+{
+    string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Write a standalone C++ scanner for dfa: the tables, a maximal-munch
+// nextToken() and a main() that prints tokens like the Lab3 lexer
+void emitScanner(ostream &out, const DFAState &dfa, const vector<LexRule> &rules, const vector<int> &order)
+{
+    size_t states = dfa.sets.size(), k = dfa.numClasses;
+    out << "// Table-driven scanner generated by Lab4 --lexgen: " << rules.size() << " rules, "
+        << states << " states, " << k << " byte classes\n";
+    out << "#include <cstdint>\n#include <cstdio>\n#include <fstream>\n#include <sstream>\n#include <string>\n\n";
+    out << "static const uint32_t DEAD = 0xFFFFFFFFu;\n";
+    out << "static const uint32_t START = " << dfa.start << ";\n";
+    out << "static const size_t CLASSES = " << k << ";\n\n";
+
+    auto writeArray = [&](const char *decl, size_t n, auto value)
+    {
+        out << decl << " = {";
+        for (size_t i = 0; i < n; ++i)
+            out << (i % 16 ? " " : "\n    ") << value(i) << ",";
+        out << "\n};\n\n";
+    };
+    writeArray("static const uint8_t classOf[256]", 256, [&](size_t i)
+               { return to_string(dfa.classOf[i]); });
+    writeArray("static const uint32_t transitions[]", states * k, [&](size_t i)
+               { return dfa.transitions[i] == DFAState::DEAD ? string("DEAD") : to_string(dfa.transitions[i]); });
+    writeArray("static const int acceptRule[]", states, [&](size_t i)
+               { return to_string(dfa.acceptRule[i]); });
+    writeArray("static const char *const ruleKind[]", rules.size(), [&](size_t i)
+               { return cString(rules[order[i]].kind); });
+    writeArray("static const bool ruleSkip[]", rules.size(), [&](size_t i)
+               { return string(rules[order[i]].kind == "skip" ? "true" : "false"); });
+
+    out << R"(// Longest match at p: the rule of the last accepting state, or -1
+static int nextToken(const char *p, const char *end, size_t *length)
+{
+    uint32_t s = START;
+    int rule = -1;
+    *length = 0;
+    for (const char *q = p; q < end;)
+    {
+        s = transitions[s * CLASSES + classOf[(unsigned char)*q++]];
+        if (s == DEAD)
+            break;
+        if (acceptRule[s] >= 0)
+        {
+            rule = acceptRule[s];
+            *length = q - p;
+        }
+    }
+    return rule;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s file\n", argv[0]);
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        fprintf(stderr, "Error: Could not open file '%s'\n", argv[1]);
+        return 1;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+
+    const char *p = text.data(), *end = p + text.size();
+    int line = 1;
+    while (p < end)
+    {
+        size_t length;
+        int rule = nextToken(p, end, &length);
+        if (rule < 0)
+        {
+            fprintf(stderr, "Lexical Error: Unrecognized token '%c' at line %d\n", *p, line);
+            line += *p++ == '\n';
+            continue;
+        }
+        for (size_t i = 0; i < length; ++i)
+            line += p[i] == '\n';
+        if (!ruleSkip[rule])
+            printf("Token: %s, Lexeme: %.*s, Line: %d\n", ruleKind[rule], (int)length, p, line);
+        p += length;
+    }
+    return 0;
+}
+)";
+}
+
+// Build the combined DFA for the rules file (or the Lab3 rules) and
+// write its scanner to outFile
+int generateLexer(const string &outFile, const string &rulesFile)
+{
+    vector<LexRule> rules = rulesFile.empty() ? lab3Rules : loadRules(rulesFile);
+    vector<int> order;
+    DFAState dfa = buildLexerDFA(rules, order);
+    ofstream out(outFile);
+    if (!out)
+    {
+        cerr << "Error: Could not write '" << outFile << "'\n";
+        return 1;
+    }
+    emitScanner(out, dfa, rules, order);
+    cout << rules.size() << " rules, " << dfa.sets.size() << " states, " << dfa.numClasses
+         << " byte classes -> " << outFile << "\n";
+    return 0;
+}
+
+// Build the combined DFA for the rules file (or the Lab3 rules) and save
+// it as a DFA file
+int saveLexerDFA(const string &outFile, const string &rulesFile)
+{
+    vector<LexRule> rules = rulesFile.empty() ? lab3Rules : loadRules(rulesFile);
+    vector<int> order;
+    DFAState dfa = buildLexerDFA(rules, order);
+    saveDFA(dfa, (uint32_t)rules.size(), outFile);
+    cout << rules.size() << " rules, " << dfa.sets.size() << " states, " << dfa.numClasses
+         << " byte classes -> " << outFile << " (" << filesystem::file_size(outFile) << " bytes)\n";
+    return 0;
+}
+
+// Lex inputFile with a DFA file saved by --save-dfa, printing tokens as
+// Lab3 does. Rule kinds are not in the file, so the same rules (the Lab3
+// rules by default) must be given again.
+int lexWithSavedDFA(const string &dfaFile, const string &inputFile, const string &rulesFile)
+{
+    vector<LexRule> rules = rulesFile.empty() ? lab3Rules : loadRules(rulesFile);
+    MappedDFA mapped(dfaFile);
+    if (mapped.numRules() != rules.size())
+        throw runtime_error("'" + dfaFile + "' was saved for " + to_string(mapped.numRules()) + " rules, not " +
+                            to_string(rules.size()));
+    ifstream in(inputFile, ios::binary);
+    if (!in)
+    {
+        cerr << "Error: Could not open file '" << inputFile << "'\n";
+        return 1;
+    }
+    stringstream buffer;
+    buffer << in.rdbuf();
+    string text = buffer.str();
+    printTokens(mapped.table(), rules, ruleOrder(rules), text.data(), text.size(), cout, cerr);
+    return 0;
+}
+
+// Discards everything written to it
+class NullBuffer : public streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char *, streamsize n) override { return n; }
+};
+
+// Generated scanner on a source file: build time, then scanning alone and
+// scanning with Lab3-style token output
+int benchmarkLexer(const string &filename, const string &rulesFile)
+{
+    using clock = chrono::steady_clock;
+    ifstream in(filename, ios::binary);
+    if (!in)
+    {
+        cerr << "Error: Could not open file '" << filename << "'\n";
+        return 1;
+    }
+    stringstream buffer;
+    buffer << in.rdbuf();
+    string text = buffer.str();
+
+    vector<LexRule> rules = rulesFile.empty() ? lab3Rules : loadRules(rulesFile);
+    vector<int> order;
+    auto t0 = clock::now();
+    DFAState dfa = buildLexerDFA(rules, order);
+    double buildMs = chrono::duration<double, milli>(clock::now() - t0).count();
+
+    vector<long> perRule(rules.size(), 0);
+    long tokens = 0, errors = 0;
+    auto t1 = clock::now();
+    for (const char *p = text.data(), *end = p + text.size(); p < end;)
+    {
+        size_t length;
+        int rank = longestMatch(dfa, p, end, length);
+        if (rank < 0)
+        {
+            ++errors;
+            ++p;
+            continue;
+        }
+        ++perRule[rank];
+        ++tokens;
+        p += length;
+    }
+    double scanSecs = chrono::duration<double>(clock::now() - t1).count();
+
+    NullBuffer nullBuffer;
+    ostream sink(&nullBuffer);
+    auto t2 = clock::now();
+    printTokens(dfa, rules, order, text.data(), text.size(), sink, sink);
+    double printSecs = chrono::duration<double>(clock::now() - t2).count();
+
+    double mb = text.size() / (1024.0 * 1024.0);
+    cout << "Source: " << mb << " MB, " << rules.size() << " rules, " << dfa.sets.size() << " states, "
+         << dfa.numClasses << " byte classes, built in " << buildMs << " ms\n";
+    cout << "scan only       : " << scanSecs * 1000 << " ms, " << mb / scanSecs << " MB/s, "
+         << tokens / scanSecs / 1e6 << " M tokens/s\n";
+    cout << "scan + printing : " << printSecs * 1000 << " ms, " << mb / printSecs << " MB/s\n";
+    cout << tokens << " tokens, " << errors << " unmatched bytes\n";
+    for (size_t rank = 0; rank < rules.size(); ++rank)
+        cout << "  " << left << setw(16) << rules[order[rank]].kind << right << setw(10) << perRule[rank]
+             << "  /" << rules[order[rank]].regex << "/\n";
+    return 0;
+}
+
+// "(a|b)*c" repeated: followpos sets stay local and the DFA grows linearly
+string chainRegex(int blocks)
+{
+    string expr;
+    for (int i = 0; i < blocks; ++i)
+        expr += "(a|b)*c";
+    return expr + "#";
+}
+
+// Starred alternation of random lowercase words, shaped like a keyword list
+string wordsRegex(int words, mt19937 &rng)
+{
+    string expr = "(";
+    for (int i = 0; i < words; ++i)
+    {
+        if (i)
+            expr += '|';
+        int len = 3 + rng() % 8;
+        for (int j = 0; j < len; ++j)
+            expr += char('a' + rng() % 26);
+    }
+    return expr + ")*#";
+}
+
+// Time each construction phase for one regex
+void timeConstruction(const string &name, const string &expr)
+{
+    using clock = chrono::steady_clock;
+    RegexCompiler compiler;
+    auto t0 = clock::now();
+    TreeNode *root = compiler.parseRegex(expr);
+    auto t1 = clock::now();
+    compiler.analyzeTree(root);
+    auto t2 = clock::now();
+    DFAState dfa = compiler.buildDFA(root);
+    auto t3 = clock::now();
+
+    auto ms = [](clock::duration d)
+    { return chrono::duration<double, milli>(d).count(); };
+    cout << left << setw(14) << name << right
+         << setw(10) << compiler.posCounter << setw(10) << dfa.sets.size()
+         << fixed << setprecision(2)
+         << setw(12) << ms(t1 - t0) << setw(12) << ms(t2 - t1)
+         << setw(12) << ms(t3 - t2) << setw(12) << ms(t3 - t0) << "\n";
+    cout.unsetf(ios::fixed);
+}
+
+// "(a|b)*a" then n more "(a|b)": the DFA must remember the last n+1
+// symbols, so subset construction produces 2^(n+1) states
+string nthFromEndRegex(int n)
+{
+    string expr = "(a|b)*a";
+    for (int i = 0; i < n; ++i)
+        expr += "(a|b)";
+    return expr + "#";
+}
+
+// Construction time on large generated regexes
+void benchmarkConstruction()
+{
+    mt19937 rng(42);
+    cout << left << setw(14) << "regex" << right
+         << setw(10) << "positions" << setw(10) << "states"
+         << setw(12) << "parse ms" << setw(12) << "analyze ms"
+         << setw(12) << "dfa ms" << setw(12) << "total ms" << "\n";
+    for (int blocks : {500, 1000, 2000, 4000})
+        timeConstruction("chain " + to_string(blocks), chainRegex(blocks));
+    for (int words : {100, 250, 500, 1000})
+        timeConstruction("words " + to_string(words), wordsRegex(words, rng));
+    for (int n : {12, 14, 16, 17})
+        timeConstruction("nth-end " + to_string(n), nthFromEndRegex(n));
+}
+
+// n random letters: concatenation makes a left-deep tree n nodes deep
+string concatRegex(int n, mt19937 &rng)
+{
+    string expr;
+    for (int i = 0; i < n; ++i)
+        expr += char('a' + rng() % 26);
+    return expr + "#";
+}
+
+// a(b(c(...))): nested groups make the tree right-deep instead
+string nestedRegex(int n, mt19937 &rng)
+{
+    string expr;
+    for (int i = 0; i < n; ++i)
+        expr += string(i ? "(" : "") + char('a' + rng() % 26);
+    return expr + string(n - 1, ')') + "#";
+}
+
+// (a|b|c|...): n alternatives, so the root's firstpos holds every position
+string alternationRegex(int n, mt19937 &rng)
+{
+    string expr = "(";
+    for (int i = 0; i < n; ++i)
+        expr += string(i ? "|" : "") + char('a' + rng() % 26);
+    return expr + ")#";
+}
+
+// Construction phases on regexes of up to maxSymbols symbols whose syntax
+// trees are about as deep as they are long
+void benchmarkDeep(int maxSymbols)
+{
+    mt19937 rng(3);
+    cout << left << setw(14) << "regex" << right
+         << setw(10) << "positions" << setw(10) << "states"
+         << setw(12) << "parse ms" << setw(12) << "analyze ms"
+         << setw(12) << "dfa ms" << setw(12) << "total ms" << "\n";
+    for (int n = 1000; n <= maxSymbols; n *= 10)
+    {
+        timeConstruction("concat " + to_string(n), concatRegex(n, rng));
+        timeConstruction("nested " + to_string(n), nestedRegex(n, rng));
+        timeConstruction("alt " + to_string(n), alternationRegex(n, rng));
+        timeConstruction("chain " + to_string(n), chainRegex(n / 7));
+    }
+}
+
+// Random input for dfa: mostly walks along existing transitions so that
+// accepting paths are exercised, with an occasional arbitrary symbol
+string randomInput(const DFAState &dfa, const string &alphabet, mt19937 &rng)
+{
+    string s;
+    int state = dfa.start;
+    int len = rng() % 40;
+    for (int i = 0; i < len; ++i)
+    {
+        char ch = alphabet[rng() % alphabet.size()];
+        for (int tries = 0; tries < 8 && state >= 0 && dfa.next(state, ch) == DFAState::DEAD; ++tries)
+            ch = alphabet[rng() % alphabet.size()];
+        s += ch;
+        state = state >= 0 && dfa.next(state, ch) != DFAState::DEAD ? (int)dfa.next(state, ch) : -1;
+    }
+    return s;
+}
+
+// Hopcroft minimization: state counts, time, and agreement on random inputs
+void timeMinimization(const string &name, const string &expr, const string &alphabet, mt19937 &rng)
+{
+    using clock = chrono::steady_clock;
+    RegexCompiler compiler;
+    DFAState dfa = compiler.compile(expr);
+
+    auto t0 = clock::now();
+    vector<int> blockOf;
+    DFAState minimized = minimizeDFA(dfa, blockOf);
+    double ms = chrono::duration<double, milli>(clock::now() - t0).count();
+
+    int agree = 0, samples = 20000;
+    for (int i = 0; i < samples; ++i)
+    {
+        string s = randomInput(dfa, alphabet, rng);
+        agree += match(dfa, s) == match(minimized, s);
+    }
+    cout << left << setw(14) << name << right
+         << setw(10) << dfa.sets.size() << setw(10) << minimized.sets.size()
+         << fixed << setprecision(2) << setw(12) << ms
+         << setw(10) << (agree == samples ? "yes" : "NO") << "\n";
+    cout.unsetf(ios::fixed);
+}
+
+void benchmarkMinimization()
+{
+    mt19937 rng(42);
+    string letters = "abcdefghijklmnopqrstuvwxyz";
+    cout << left << setw(14) << "regex" << right
+         << setw(10) << "before" << setw(10) << "after"
+         << setw(12) << "min ms" << setw(10) << "agree" << "\n";
+    timeMinimization("test 2", "a*b*a(a|b)*b*a#", "ab", rng);
+    for (int blocks : {1000, 4000})
+        timeMinimization("chain " + to_string(blocks), chainRegex(blocks), "abc", rng);
+    for (int words : {250, 1000})
+        timeMinimization("words " + to_string(words), wordsRegex(words, rng), letters, rng);
+    for (int n : {12, 16})
+        timeMinimization("nth-end " + to_string(n), nthFromEndRegex(n), "ab", rng);
+}
+
+// Report throughput of one matcher run over text
+template <class F>
+void timeMatcher(const string &name, const DFAState &dfa, const string &text, F run)
+{
+    auto t0 = chrono::steady_clock::now();
+    long result = run();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << left << setw(22) << name << right
+         << setw(8) << dfa.sets.size() << setw(6) << dfa.numClasses
+         << fixed << setprecision(2) << setw(10) << secs * 1000
+         << setw(8) << text.size() / secs / 1e9 << setw(12) << result << "\n";
+    cout.unsetf(ios::fixed);
+}
+
+// All non-overlapping matches in text, counted by their earliest end;
+// search(p, n) is search() of some matcher
+template <class Search>
+long countMatches(const string &text, Search search)
+{
+    long count = 0;
+    size_t off = 0;
+    while (off < text.size())
+    {
+        long end = search(text.data() + off, text.size() - off);
+        if (end < 0)
+            break;
+        ++count;
+        off += max(end, 1L);
+    }
+    return count;
+}
+
+long countMatches(const DFATable &dfa, const string &text)
+{
+    return countMatches(text, [&](const char *p, size_t n)
+                        { return search(dfa, p, n); });
+}
+
+// match/search throughput over large random texts
+void benchmarkMatcher(size_t megabytes)
+{
+    mt19937 rng(7);
+    string letters(megabytes << 20, ' '), ab(megabytes << 20, ' ');
+    for (char &ch : letters)
+        ch = char('a' + rng() % 26);
+    for (char &ch : ab)
+        ch = rng() & 1 ? 'a' : 'b';
+
+    string anyLetter = "(";
+    for (char ch = 'a'; ch <= 'z'; ++ch)
+        anyLetter += string(ch == 'a' ? "" : "|") + ch;
+    anyLetter += ")*#";
+
+    cout << "Text: " << megabytes << " MB per run\n";
+    cout << left << setw(22) << "run" << right << setw(8) << "states" << setw(6) << "cls"
+         << setw(10) << "ms" << setw(8) << "GB/s" << setw(12) << "result" << "\n";
+
+    RegexCompiler compiler;
+    DFAState letterDFA = compiler.compile(anyLetter);
+    timeMatcher("match [a-z]*", letterDFA, letters, [&]
+                { return (long)match(letterDFA, letters.data(), letters.size()); });
+
+    DFAState keywords = compiler.compile("(while|return|struct|static|switch)#", true);
+    timeMatcher("search keywords", keywords, letters, [&]
+                { return countMatches(keywords, letters); });
+
+    DFAState nthEnd = compiler.compile(nthFromEndRegex(8), true);
+    timeMatcher("search nth-end 8", nthEnd, ab, [&]
+                { return countMatches(nthEnd, ab); });
+
+    DFAState rare = compiler.compile("abbabbaabbbabaabbbbbbaaab#", true);
+    timeMatcher("search 25-char word", rare, ab, [&]
+                { return countMatches(rare, ab); });
+}
+
+// Token rules of a C lexer
+const vector<string> cLexerRules = {
+    R"([A-Za-z_][A-Za-z0-9_]*)",
+    R"([0-9]+(\.[0-9]+)?([eE][+\-]?[0-9]+)?[fFlL]?)",
+    R"(0[xX][0-9a-fA-F]+[uUlL]*)",
+    R"("([^"\\\n]|\\.)*")",
+    R"('([^'\\\n]|\\.)+')",
+    R"(/\*([^*]|\*+[^*/])*\*+/)",
+    R"(//[^\n]*)",
+    R"([ \t\r\n]+)",
+    R"(\+\+|--|->|<<=?|>>=?|[<>=!]=|&&|\|\||[+\-*/%&|^]=?|[~?:;,.(){}\[\]<>=!])",
+};
+
+const vector<string> cKeywords = {
+    "auto", "break", "case", "char", "const", "continue", "default", "do",
+    "double", "else", "enum", "extern", "float", "for", "goto", "if",
+    "int", "long", "register", "return", "short", "signed", "sizeof", "static",
+    "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while"};
+
+// Token rules of a JSON lexer
+const vector<string> jsonRules = {
+    R"("([^"\\\x00-\x1f]|\\["\\/bfnrt]|\\u[0-9a-fA-F]{4})*")",
+    R"(-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+\-]?[0-9]+)?)",
+    R"(true|false|null)",
+    R"([{}\[\]:,])",
+    R"([ \t\r\n]+)",
+};
+
+// The regex with every multi-byte leaf spelled out as an alternation of
+// single bytes, i.e. what classes cost without byte-set leaves
+string expandClasses(const string &expr)
+{
+    string out;
+    char hex[8];
+    for (const RegexToken &tok : tokenizeRegex(expr))
+    {
+        if (tok.op || tok.bytes.count() <= 1)
+        {
+            out += tok.text;
+            continue;
+        }
+        out += '(';
+        for (int b = 0; b < 256; ++b)
+        {
+            if (!tok.bytes[b])
+                continue;
+            snprintf(hex, sizeof hex, "%s\\x%02x", out.back() == '(' ? "" : "|", b);
+            out += hex;
+        }
+        out += ')';
+    }
+    return out;
+}
+
+// A rule set as one regex: the rules' alternation, then the end marker
+string ruleSetRegex(const vector<string> &rules)
+{
+    string expr;
+    for (const string &rule : rules)
+        expr += (expr.empty() ? "(" : "|(") + rule + ")";
+    return "(" + expr + ")#";
+}
+
+// Build time of one rule set as a single alternation, with byte-set
+// leaves and with classes expanded
+void timeRuleSet(const string &name, const vector<string> &rules)
+{
+    using clock = chrono::steady_clock;
+    string expr = ruleSetRegex(rules);
+
+    RegexCompiler compiler;
+    size_t results[2][2];
+    double ms[2];
+    string variants[2] = {expr, expandClasses(expr)};
+    for (int v = 0; v < 2; ++v)
+    {
+        auto t0 = clock::now();
+        DFAState dfa = compiler.compile(variants[v]);
+        ms[v] = chrono::duration<double, milli>(clock::now() - t0).count();
+        results[v][0] = compiler.posCounter;
+        results[v][1] = dfa.sets.size();
+    }
+    cout << left << setw(16) << name << right << setw(6) << rules.size()
+         << setw(10) << results[0][0] << setw(10) << results[1][0]
+         << setw(8) << results[0][1] << fixed << setprecision(2)
+         << setw(10) << ms[0] << setw(12) << ms[1] << "\n";
+    cout.unsetf(ios::fixed);
+    if (results[0][1] != results[1][1])
+        cout << "  state counts differ: " << results[0][1] << " vs " << results[1][1] << "\n";
+}
+
+// DFA build time on lexer rule sets
+void benchmarkRuleSets()
+{
+    vector<string> withKeywords = cKeywords;
+    withKeywords.insert(withKeywords.end(), cLexerRules.begin(), cLexerRules.end());
+    cout << left << setw(16) << "rule set" << right << setw(6) << "rules"
+         << setw(10) << "positions" << setw(10) << "expanded" << setw(8) << "states"
+         << setw(10) << "build ms" << setw(12) << "expanded ms" << "\n";
+    timeRuleSet("json", jsonRules);
+    timeRuleSet("c tokens", cLexerRules);
+    timeRuleSet("c + keywords", withKeywords);
+}
+
+// Lazy DFA for expr, with its own copy of the position tables
+LazyDFA compileLazy(const string &expr, size_t maxStates, bool unanchored)
+{
+    RegexCompiler compiler;
+    TreeNode *root = compiler.analyzeRegex(expr);
+    return LazyDFA(compiler, root, maxStates, unanchored);
+}
+
+// Time one lazy DFA run and show its cache counters
+template <class F>
+void timeLazy(const string &name, size_t maxStates, LazyDFA &lazy, size_t bytes, F run)
+{
+    auto t0 = chrono::steady_clock::now();
+    long result = run();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    const LazyDFA::Counters &c = lazy.counters();
+    cout << left << setw(16) << name << right << setw(9) << maxStates
+         << fixed << setprecision(1) << setw(9) << secs * 1000 << setw(8) << bytes / secs / 1e6
+         << setw(9) << lazy.cachedStates() << setw(11) << c.hits << setw(10) << c.misses
+         << setw(8) << c.flushes << setw(10) << c.simulatedBytes / 1e6 << setw(10) << result << "\n";
+    cout.unsetf(ios::fixed);
+}
+
+// Lazy DFA on "(a|b)*a(a|b){n}", whose eager DFA has 2^(n+1) states
+void benchmarkLazy(size_t megabytes)
+{
+    mt19937 rng(11);
+    string ab(megabytes << 20, ' ');
+    for (char &ch : ab)
+        ch = rng() & 1 ? 'a' : 'b';
+
+    // Small n: the lazy DFA must agree with the eager one at every cache size
+    string small = "(a|b)*a(a|b){9}#";
+    RegexCompiler compiler;
+    DFAState eager = compiler.compile(small), eagerSearch = compiler.compile(small, true);
+    string sample = ab.substr(0, 1 << 20);
+    long want = countMatches(eagerSearch, sample);
+    bool agree = true;
+    for (size_t cache : {8, 64, 256, 4096})
+    {
+        LazyDFA lazy = compileLazy(small, cache, true), anchored = compileLazy(small, cache, false);
+        agree &= countMatches(sample, [&](const char *p, size_t n)
+                              { return lazy.search(p, n); }) == want;
+        for (int i = 0; i < 2000; ++i)
+        {
+            size_t off = rng() % (sample.size() - 64), len = rng() % 64;
+            agree &= anchored.match(sample.data() + off, len) == match(eager, sample.data() + off, len);
+        }
+    }
+    cout << "Eager (" << eager.sets.size() << " states) and lazy DFAs agree: " << (agree ? "yes" : "NO") << "\n\n";
+
+    cout << "Text: " << megabytes << " MB of random a/b\n";
+    cout << left << setw(16) << "run" << right << setw(9) << "cache" << setw(9) << "ms"
+         << setw(8) << "MB/s" << setw(9) << "states" << setw(11) << "hits" << setw(10) << "misses"
+         << setw(8) << "flushes" << setw(10) << "sim MB" << setw(10) << "result" << "\n";
+    for (int n : {12, 20})
+    {
+        string expr = nthFromEndRegex(n);
+        for (size_t cache : {1u << 10, 1u << 14, 1u << 18})
+        {
+            LazyDFA anchored = compileLazy(expr, cache, false);
+            timeLazy("match n=" + to_string(n), cache, anchored, ab.size(), [&]
+                     { return (long)anchored.match(ab.data(), ab.size()); });
+        }
+        for (size_t cache : {1u << 10, 1u << 18})
+        {
+            LazyDFA lazy = compileLazy(expr, cache, true);
+            timeLazy("search n=" + to_string(n), cache, lazy, ab.size(), [&]
+                     { return countMatches(ab, [&](const char *p, size_t len)
+                                           { return lazy.search(p, len); }); });
+        }
+    }
+}
+
+// Maximal-munch scan of text, skipping unmatched bytes; a checksum of the
+// rules and lengths of the lexemes found
+uint64_t scanChecksum(const DFATable &dfa, const string &text)
+{
+    uint64_t sum = 0;
+    for (const char *p = text.data(), *end = p + text.size(); p < end;)
+    {
+        size_t length;
+        int rule = longestMatch(dfa, p, end, length);
+        sum = sum * 31 + (uint64_t)(rule + 1) * 1000003 + length;
+        p += rule < 0 ? 1 : length;
+    }
+    return sum;
+}
+
+// Startup cost of one DFA: build it from its regexes, or map its saved
+// file. Loads are averaged over many mappings of the cached file; the
+// first scan after a load also pays for faulting in the pages it touches.
+template <class Build>
+void timeStartup(const string &name, Build build, const string &text, const string &path)
+{
+    using clock = chrono::steady_clock;
+    auto t0 = clock::now();
+    DFAState dfa = build();
+    double compileMs = chrono::duration<double, milli>(clock::now() - t0).count();
+    saveDFA(dfa, *max_element(dfa.acceptRule.begin(), dfa.acceptRule.end()) + 1, path);
+
+    const int loads = 2000;
+    uint64_t states = 0;
+    auto t1 = clock::now();
+    for (int i = 0; i < loads; ++i)
+    {
+        MappedDFA mapped(path);
+        states += mapped.table().numStates;
+    }
+    double loadUs = chrono::duration<double, micro>(clock::now() - t1).count() / loads;
+
+    MappedDFA mapped(path);
+    bool agree = states == (uint64_t)loads * dfa.isAccept.size() &&
+                 scanChecksum(mapped.table(), text) == scanChecksum(dfa, text);
+    cout << left << setw(16) << name << right << setw(9) << dfa.isAccept.size()
+         << setw(10) << filesystem::file_size(path) / 1024 << fixed << setprecision(2)
+         << setw(12) << compileMs << setw(10) << loadUs << setprecision(0)
+         << setw(10) << compileMs * 1000 / loadUs << setw(8) << (agree ? "yes" : "NO") << "\n";
+    cout.unsetf(ios::fixed);
+}
+
+// Cold compile against mmap load of the saved DFA, for lexer rule sets and
+// a large DFA
+void benchmarkStartup()
+{
+    mt19937 rng(9);
+    string alphabet = "abcdefghijklmnopqrstuvwxyz_0123456789 \n\t+-*/=<>!&|;,.(){}[]\"'#";
+    string text(1 << 20, ' ');
+    for (char &ch : text)
+        ch = alphabet[rng() % alphabet.size()];
+    string path = (filesystem::temp_directory_path() / "lab4-startup.dfa").string();
+
+    auto lexer = [](vector<LexRule> rules)
+    {
+        vector<int> order;
+        return buildLexerDFA(rules, order);
+    };
+    auto ruleList = [](const vector<string> &regexes, size_t keywords)
+    {
+        vector<LexRule> rules;
+        for (size_t i = 0; i < regexes.size(); ++i)
+            rules.push_back({"rule" + to_string(i), i < keywords ? 2 : 1, regexes[i]});
+        return rules;
+    };
+    vector<string> withKeywords = cKeywords;
+    withKeywords.insert(withKeywords.end(), cLexerRules.begin(), cLexerRules.end());
+    string words = wordsRegex(1000, rng);
+
+    cout << left << setw(16) << "dfa" << right << setw(9) << "states" << setw(10) << "file KB"
+         << setw(12) << "compile ms" << setw(10) << "load us" << setw(10) << "speedup"
+         << setw(8) << "agree" << "\n";
+    timeStartup("lab3 rules", [&]
+                { return lexer(lab3Rules); }, text, path);
+    timeStartup("json", [&]
+                { return lexer(ruleList(jsonRules, 0)); }, text, path);
+    timeStartup("c + keywords", [&]
+                { return lexer(ruleList(withKeywords, cKeywords.size())); }, text, path);
+    timeStartup("words 1000", [&]
+                {
+                    RegexCompiler compiler;
+                    vector<int> blockOf;
+                    return minimizeDFA(compiler.compile(words), blockOf); }, text, path);
+    timeStartup("nth-end 16", [&]
+                { return RegexCompiler().compile(nthFromEndRegex(16)); }, text, path);
+
+    // Each array of a saved lexer DFA broken in turn must be refused
+    DFAState dfa = lexer(lab3Rules);
+    saveDFA(dfa, (uint32_t)lab3Rules.size(), path);
+    ifstream in(path, ios::binary);
+    string good((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    DFAFileHeader h;
+    memcpy(&h, good.data(), sizeof h);
+    auto put32 = [](uint32_t v)
+    { return string(reinterpret_cast<const char *>(&v), 4); };
+    vector<pair<uint64_t, string>> damage = {
+        {h.transitionsOffset, put32(h.numStates)},
+        {h.classOfOffset + 'a', string(1, (char)h.numClasses)},
+        {h.acceptRuleOffset, put32(h.numRules)},
+        {h.acceptRuleOffset, put32((uint32_t)-2)},
+        {h.isAcceptOffset, string(1, (char)!dfa.isAccept[0])},
+        {offsetof(DFAFileHeader, classOfOffset), string(8, '\xff')},
+    };
+    int rejected = 0;
+    for (auto &[offset, bytes] : damage)
+    {
+        string bad = good;
+        bad.replace(offset, bytes.size(), bytes);
+        ofstream(path, ios::binary) << bad;
+        try
+        {
+            MappedDFA mapped(path);
+        }
+        catch (const runtime_error &)
+        {
+            ++rejected;
+        }
+    }
+    cout << "\nCorrupt DFA files rejected: " << rejected << " of " << damage.size() << "\n";
+    filesystem::remove(path);
+}
+
+// Fingerprint of a DFA's transitions and accepting states
+uint64_t hashDFA(const DFAState &dfa)
+{
+    uint64_t h = dfa.sets.size();
+    for (uint32_t t : dfa.transitions)
+        h = (h ^ t) * 0x100000001B3ULL;
+    for (int rule : dfa.acceptRule)
+        h = (h ^ (uint32_t)rule) * 0x100000001B3ULL;
+    return h;
+}
+
+// Compile throughput with 1..maxThreads threads. The same batch of regexes
+// is shared out through an atomic counter; each thread reuses one compiler,
+// and every DFA must equal the one built on the main thread.
+void benchmarkThreads(int maxThreads)
+{
+    mt19937 rng(5);
+    vector<string> withKeywords = cKeywords;
+    withKeywords.insert(withKeywords.end(), cLexerRules.begin(), cLexerRules.end());
+    vector<string> regexes = {
+        "(a|b)*abb#", "a*b*a(a|b)*b*a#", ruleSetRegex(jsonRules), ruleSetRegex(cLexerRules),
+        ruleSetRegex(withKeywords), chainRegex(100), nthFromEndRegex(8)};
+    for (int words : {20, 50, 100})
+        regexes.push_back(wordsRegex(words, rng));
+
+    vector<uint64_t> want;
+    RegexCompiler compiler;
+    for (const string &expr : regexes)
+        want.push_back(hashDFA(compiler.compile(expr)));
+
+    size_t jobs = regexes.size() * 40;
+    cout << "Batch: " << jobs << " compiles of " << regexes.size() << " regexes, "
+         << thread::hardware_concurrency() << " hardware threads\n";
+    cout << setw(8) << "threads" << setw(10) << "ms" << setw(14) << "compiles/s"
+         << setw(10) << "speedup" << setw(8) << "agree" << "\n";
+    double base = 0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        atomic<size_t> nextJob{0};
+        atomic<bool> agree{true};
+        auto worker = [&]()
+        {
+            RegexCompiler local;
+            for (size_t job; (job = nextJob++) < jobs;)
+                if (hashDFA(local.compile(regexes[job % regexes.size()])) != want[job % regexes.size()])
+                    agree = false;
+        };
+        auto t0 = chrono::steady_clock::now();
+        vector<thread> pool;
+        for (int i = 0; i < threads; ++i)
+            pool.emplace_back(worker);
+        for (thread &t : pool)
+            t.join();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        if (threads == 1)
+            base = secs;
+        cout << setw(8) << threads << fixed << setprecision(1) << setw(10) << secs * 1000
+             << setw(14) << jobs / secs << setprecision(2) << setw(10) << base / secs
+             << setw(8) << (agree ? "yes" : "NO") << "\n";
+        cout.unsetf(ios::fixed);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 2 && string(argv[1]) == "--bench")
+    {
+        benchmarkConstruction();
+        return 0;
+    }
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--bench-deep")
+    {
+        benchmarkDeep(argc == 3 ? stoi(argv[2]) : 1000000);
+        return 0;
+    }
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--bench-match")
+    {
+        benchmarkMatcher(argc == 3 ? stoul(argv[2]) : 64);
+        return 0;
+    }
+    try
+    {
+        if ((argc == 3 || argc == 4) && string(argv[1]) == "--lexgen")
+            return generateLexer(argv[2], argc == 4 ? argv[3] : "");
+        if ((argc == 3 || argc == 4) && string(argv[1]) == "--bench-lexer")
+            return benchmarkLexer(argv[2], argc == 4 ? argv[3] : "");
+        if ((argc == 4 || argc == 5) && string(argv[1]) == "--load-dfa")
+            return lexWithSavedDFA(argv[2], argv[3], argc == 5 ? argv[4] : "");
+        if ((argc == 3 || argc == 4) && string(argv[1]) == "--save-dfa")
+            return saveLexerDFA(argv[2], argc == 4 ? argv[3] : "");
+        if (argc == 2 && string(argv[1]) == "--bench-startup")
+        {
+            benchmarkStartup();
+            return 0;
+        }
+    }
+    catch (const runtime_error &e)
+    {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--bench-lazy")
+    {
+        benchmarkLazy(argc == 3 ? stoul(argv[2]) : 16);
+        return 0;
+    }
+    if (argc == 2 && string(argv[1]) == "--bench-rules")
+    {
+        benchmarkRuleSets();
+        return 0;
+    }
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--bench-threads")
+    {
+        benchmarkThreads(argc == 3 ? stoi(argv[2]) : max(4, (int)thread::hardware_concurrency()));
+        return 0;
+    }
+    if (argc == 2 && string(argv[1]) == "--bench-min")
+    {
+        benchmarkMinimization();
+        return 0;
     }
-    cout << "\n";
-}
 
-int main()
-{
     cout << "DFA CONSTRUCTION FROM REGULAR EXPRESSION\n";
     cout << "Using Syntax-Tree-Based Method\n";
     cout << string(60, '=') << "\n";
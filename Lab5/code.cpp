@@ -1,9 +1,56 @@
 #include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 using namespace std;
 
 static const string EPS = "ε";
 static const string END_MARKER = "$";
 
+// Set of terminal IDs as a dense bitset, one bit per terminal plus the
+// grammar's eps_bit for ε. Unions run a word at a time.
+struct TermSet
+{
+    vector<uint64_t> words;
+
+    void resize(int bits) { words.assign((bits + 63) / 64, 0); }
+
+    bool contains(int t) const { return (words[t >> 6] >> (t & 63)) & 1; }
+
+    // Add t; true if it was not there yet
+    bool insert(int t)
+    {
+        uint64_t bit = uint64_t(1) << (t & 63);
+        bool added = !(words[t >> 6] & bit);
+        words[t >> 6] |= bit;
+        return added;
+    }
+
+    // this |= o, leaving out bit skip (-1 for none); true if anything was added
+    bool unite(const TermSet &o, int skip = -1)
+    {
+        size_t skipWord = skip < 0 ? words.size() : (size_t)skip >> 6;
+        uint64_t skipMask = skip < 0 ? 0 : uint64_t(1) << (skip & 63);
+        uint64_t added = 0;
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            uint64_t w = o.words[i] & ~(i == skipWord ? skipMask : 0);
+            added |= w & ~words[i];
+            words[i] |= w;
+        }
+        return added != 0;
+    }
+
+    template <class F>
+    void for_each(F f) const
+    {
+        for (size_t i = 0; i < words.size(); ++i)
+            for (uint64_t w = words[i]; w; w &= w - 1)
+                f((int)(i * 64 + __builtin_ctzll(w)));
+    }
+};
+
 struct Grammar
 {
     unordered_map<string, vector<vector<string>>> productions;
@@ -11,9 +58,49 @@ struct Grammar
     unordered_set<string> nonterminals;
     unordered_set<string> terminals;
     string start;
-    unordered_map<string, unordered_set<string>> FIRST;
-    unordered_map<string, unordered_set<string>> FOLLOW;
-    unordered_map<string, unordered_map<string, vector<string>>> table;
+
+    // Interned form, filled by intern_symbols(). Terminals are numbered in
+    // name order and nonterminals in nonterminals_list order. In a rule, a
+    // symbol s >= 0 is nonterminal s and s < 0 is terminal ~s.
+    vector<string> terminal_names;
+    unordered_map<string, int> terminal_id;
+    unordered_map<string, int> nonterminal_id;
+    vector<vector<vector<int>>> rules; // rules[A][p] is productions[A][p] without ε
+    vector<vector<int>> nullable_from; // rules[A][p][i..] is nullable iff i >= nullable_from[A][p]
+    int eps_bit = 0;                   // == number of terminals
+    vector<TermSet> FIRST;             // by nonterminal ID
+    vector<TermSet> FOLLOW;
+
+    // Productions numbered in rules order: head, index among the head's
+    // productions, and the body reversed, as the parser pushes it, at
+    // pushes[push_start[id] .. push_start[id + 1])
+    vector<int> prod_head;
+    vector<int> prod_alt;
+    vector<int> push_start;
+    vector<int> pushes;
+    vector<int16_t> table; // [A * terminals + a]: production ID, or -1
+
+    // Symbol names back to back, terminals then nonterminals: name k is
+    // name_text[name_start[k] .. name_start[k + 1])
+    string name_text;
+    vector<uint32_t> name_start;
+};
+
+// What predictive_parse reads, as arrays: pointed into a Grammar by
+// parse_table() or into a mapped table file by MappedTable
+struct ParseTable
+{
+    int terminals = 0;
+    int nonterminals = 0;
+    int productions = 0;
+    int start = 0; // start nonterminal
+    int end = 0;   // END_MARKER's terminal ID
+    const int16_t *table = nullptr;
+    const int32_t *prod_head = nullptr;
+    const int32_t *push_start = nullptr;
+    const int32_t *pushes = nullptr;
+    const uint32_t *name_start = nullptr;
+    const char *name_text = nullptr;
 };
 
 string trim(const string &s)
@@ -75,194 +162,674 @@ void collect_terminals(Grammar &G)
     G.terminals.insert(END_MARKER);
 }
 
-bool add_to_set(unordered_set<string> &s, const unordered_set<string> &add)
+// Number the symbols and rewrite every production as symbol IDs
+void intern_symbols(Grammar &G)
+{
+    G.terminal_names.assign(G.terminals.begin(), G.terminals.end());
+    sort(G.terminal_names.begin(), G.terminal_names.end());
+    G.terminal_id.clear();
+    for (size_t t = 0; t < G.terminal_names.size(); ++t)
+        G.terminal_id[G.terminal_names[t]] = (int)t;
+    G.nonterminal_id.clear();
+    for (size_t A = 0; A < G.nonterminals_list.size(); ++A)
+        G.nonterminal_id[G.nonterminals_list[A]] = (int)A;
+    G.eps_bit = (int)G.terminal_names.size();
+
+    G.rules.assign(G.nonterminals_list.size(), {});
+    for (size_t A = 0; A < G.nonterminals_list.size(); ++A)
+    {
+        for (const vector<string> &alt : G.productions[G.nonterminals_list[A]])
+        {
+            vector<int> rhs;
+            for (const string &sym : alt)
+            {
+                if (sym == EPS)
+                    continue;
+                auto nt = G.nonterminal_id.find(sym);
+                rhs.push_back(nt != G.nonterminal_id.end() ? nt->second : ~G.terminal_id.at(sym));
+            }
+            G.rules[A].push_back(rhs);
+        }
+    }
+
+    G.prod_head.clear();
+    G.prod_alt.clear();
+    G.pushes.clear();
+    G.push_start.assign(1, 0);
+    for (size_t A = 0; A < G.rules.size(); ++A)
+    {
+        for (size_t p = 0; p < G.rules[A].size(); ++p)
+        {
+            G.prod_head.push_back((int)A);
+            G.prod_alt.push_back((int)p);
+            G.pushes.insert(G.pushes.end(), G.rules[A][p].rbegin(), G.rules[A][p].rend());
+            G.push_start.push_back((int)G.pushes.size());
+        }
+    }
+
+    G.name_text.clear();
+    G.name_start.assign(1, 0);
+    for (const vector<string> *names : {&G.terminal_names, &G.nonterminals_list})
+    {
+        for (const string &name : *names)
+        {
+            G.name_text += name;
+            G.name_start.push_back((uint32_t)G.name_text.size());
+        }
+    }
+}
+
+// G's parse table in place; valid while G is unchanged
+ParseTable parse_table(const Grammar &G)
 {
-    size_t before = s.size();
-    for (auto it = add.begin(); it != add.end(); ++it)
-        s.insert(*it);
-    return s.size() != before;
+    static_assert(sizeof(int) == sizeof(int32_t), "production arrays are read as int32");
+    ParseTable P;
+    P.terminals = (int)G.terminal_names.size();
+    P.nonterminals = (int)G.nonterminals_list.size();
+    P.productions = (int)G.prod_head.size();
+    P.start = G.nonterminal_id.at(G.start);
+    P.end = G.terminal_id.at(END_MARKER);
+    P.table = G.table.data();
+    P.prod_head = G.prod_head.data();
+    P.push_start = G.push_start.data();
+    P.pushes = G.pushes.data();
+    P.name_start = G.name_start.data();
+    P.name_text = G.name_text.data();
+    return P;
 }
 
-bool add_to_set_excluding_epsilon(unordered_set<string> &dest, const unordered_set<string> &src)
+string_view symbol_name(const ParseTable &P, int s)
 {
-    size_t before = dest.size();
-    for (auto it = src.begin(); it != src.end(); ++it)
-        if (*it != EPS)
-            dest.insert(*it);
-    return dest.size() != before;
+    int k = s >= 0 ? P.terminals + s : ~s;
+    return string_view(P.name_text + P.name_start[k], P.name_start[k + 1] - P.name_start[k]);
 }
 
-const unordered_set<string> &FIRST_of_symbol(Grammar &G, const string &X)
+// Terminal ID of name by binary search (terminals are numbered in name
+// order), or -1
+int terminal_id(const ParseTable &P, string_view name)
 {
-    static unordered_map<string, unordered_set<string>> cacheTerm;
-    if (!G.nonterminals.count(X))
+    int lo = 0, hi = P.terminals;
+    while (lo < hi)
     {
-        if (cacheTerm.count(X))
-            return cacheTerm[X];
-        unordered_set<string> tmp;
-        tmp.insert(X);
-        cacheTerm[X] = tmp;
-        return cacheTerm[X];
+        int mid = (lo + hi) / 2;
+        if (symbol_name(P, ~mid) < name)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
 
-    return G.FIRST[X];
+    return lo < P.terminals && symbol_name(P, ~lo) == name ? lo : -1;
 }
 
-void compute_FIRST(Grammar &G)
+// Body of production id from its pushes, ε when empty
+string production_rhs(const ParseTable &P, int id)
 {
-    for (size_t i = 0; i < G.nonterminals_list.size(); ++i)
-        G.FIRST[G.nonterminals_list[i]];
+    string rhs;
+    for (int i = P.push_start[id + 1]; i-- > P.push_start[id];)
+        rhs += string(rhs.empty() ? "" : " ") + string(symbol_name(P, P.pushes[i]));
+    return rhs.empty() ? EPS : rhs;
+}
+
+TermSet empty_set(const Grammar &G)
+{
+    TermSet s;
+    s.resize(G.eps_bit + 1);
+    return s;
+}
+
+// Fixpoint sweeps over every production until nothing changes, as FIRST
+// was computed before compute_FIRST. Kept as a reference for the solver
+// and for the benchmark; returns the number of passes.
+int compute_FIRST_sweep(Grammar &G)
+{
+    G.FIRST.assign(G.nonterminals_list.size(), empty_set(G));
+    int passes = 0;
     bool changed = true;
     while (changed)
     {
+        ++passes;
         changed = false;
-        for (size_t idx = 0; idx < G.nonterminals_list.size(); ++idx)
+        for (size_t A = 0; A < G.rules.size(); ++A)
         {
-            const string &A = G.nonterminals_list[idx];
-            for (size_t p = 0; p < G.productions[A].size(); ++p)
+            for (const vector<int> &alpha : G.rules[A])
             {
-                const vector<string> &alpha = G.productions[A][p];
                 bool allNullable = true;
-                for (size_t i = 0; i < alpha.size(); ++i)
+                for (int X : alpha)
                 {
-                    string X = alpha[i];
-                    const auto &F_X = FIRST_of_symbol(G, X);
-                    if (add_to_set_excluding_epsilon(G.FIRST[A], F_X))
-                        changed = true;
-                    if (!F_X.count(EPS))
+                    if (X < 0)
                     {
+                        if (G.FIRST[A].insert(~X))
+                            changed = true;
                         allNullable = false;
                         break;
                     }
-                }
-
-                if (allNullable)
-                {
-                    if (!G.FIRST[A].count(EPS))
-                    {
-                        G.FIRST[A].insert(EPS);
+                    if (G.FIRST[A].unite(G.FIRST[X], G.eps_bit))
                         changed = true;
+                    if (!G.FIRST[X].contains(G.eps_bit))
+                    {
+                        allNullable = false;
+                        break;
                     }
                 }
+
+                if (allNullable && G.FIRST[A].insert(G.eps_bit))
+                    changed = true;
             }
         }
     }
+
+    return passes;
 }
 
-unordered_set<string> FIRST_of_sequence(Grammar &G, const vector<string> &alpha)
+// FIRST of alpha[from..], with eps_bit set when that suffix is nullable
+TermSet FIRST_of_sequence(const Grammar &G, const vector<int> &alpha, size_t from = 0)
 {
-    unordered_set<string> res;
-    if (alpha.empty())
+    TermSet res = empty_set(G);
+    for (size_t i = from; i < alpha.size(); ++i)
     {
-        res.insert(EPS);
-        return res;
-    }
-
-    bool allNullable = true;
-    for (size_t i = 0; i < alpha.size(); ++i)
-    {
-        const auto &FX = FIRST_of_symbol(G, alpha[i]);
-        for (auto it = FX.begin(); it != FX.end(); ++it)
-            if (*it != EPS)
-                res.insert(*it);
-        if (!FX.count(EPS))
+        int X = alpha[i];
+        if (X < 0)
         {
-            allNullable = false;
-            break;
+            res.insert(~X);
+            return res;
         }
+        res.unite(G.FIRST[X], G.eps_bit);
+        if (!G.FIRST[X].contains(G.eps_bit))
+            return res;
     }
 
-    if (allNullable)
-        res.insert(EPS);
+    res.insert(G.eps_bit);
     return res;
 }
 
-void compute_FOLLOW(Grammar &G)
+// Fixpoint sweeps for FOLLOW, the counterpart of compute_FIRST_sweep
+int compute_FOLLOW_sweep(Grammar &G)
 {
-    for (size_t i = 0; i < G.nonterminals_list.size(); ++i)
-        G.FOLLOW[G.nonterminals_list[i]];
-    G.FOLLOW[G.start].insert(END_MARKER);
+    G.FOLLOW.assign(G.nonterminals_list.size(), empty_set(G));
+    G.FOLLOW[G.nonterminal_id.at(G.start)].insert(G.terminal_id.at(END_MARKER));
+    int passes = 0;
     bool changed = true;
     while (changed)
     {
+        ++passes;
         changed = false;
-        for (auto it = G.productions.begin(); it != G.productions.end(); ++it)
+        for (size_t A = 0; A < G.rules.size(); ++A)
         {
-            const string &A = it->first;
-            auto &alts = it->second;
-            for (size_t p = 0; p < alts.size(); ++p)
+            for (const vector<int> &alpha : G.rules[A])
             {
-                const vector<string> &alpha = alts[p];
                 for (size_t i = 0; i < alpha.size(); ++i)
                 {
-                    string B = alpha[i];
-                    if (!G.nonterminals.count(B))
+                    int B = alpha[i];
+                    if (B < 0)
                         continue;
-                    vector<string> beta;
-                    for (size_t j = i + 1; j < alpha.size(); ++j)
-                        beta.push_back(alpha[j]);
-                    auto FIRST_beta = FIRST_of_sequence(G, beta);
-                    if (add_to_set_excluding_epsilon(G.FOLLOW[B], FIRST_beta))
+                    TermSet FIRST_beta = FIRST_of_sequence(G, alpha, i + 1);
+                    if (G.FOLLOW[B].unite(FIRST_beta, G.eps_bit))
                         changed = true;
-                    if (FIRST_beta.count(EPS))
+                    if (FIRST_beta.contains(G.eps_bit))
                     {
-                        if (add_to_set(G.FOLLOW[B], G.FOLLOW[A]))
+                        if (G.FOLLOW[B].unite(G.FOLLOW[A]))
                             changed = true;
                     }
                 }
             }
         }
     }
+
+    return passes;
 }
 
-bool build_LL1_table(Grammar &G, vector<string> &conflicts)
+// Least sets with sets[v] ⊇ sets[w] for every w in deps[v], on top of the
+// initial sets[v]. Tarjan's algorithm (with an explicit DFS stack) closes
+// each strongly connected component of the dependency graph only after
+// every component it depends on, so one union per member and per edge
+// leaving the component settles it for good: the members of a cycle all
+// get the same set. Returns the number of set unions.
+long solve_inclusions(const vector<vector<int>> &deps, vector<TermSet> &sets)
 {
-    bool ok = true;
-    for (size_t idx = 0; idx < G.nonterminals_list.size(); ++idx)
+    int n = (int)deps.size();
+    vector<int> index(n, -1), low(n), comp(n, -1), stk, members;
+    vector<pair<int, size_t>> dfs; // (node, next dependency to visit)
+    int counter = 0;
+    long unions = 0;
+    auto visit = [&](int v)
     {
-        const string &A = G.nonterminals_list[idx];
-        for (size_t p = 0; p < G.productions[A].size(); ++p)
+        index[v] = low[v] = counter++;
+        stk.push_back(v);
+        dfs.push_back({v, 0});
+    };
+    for (int root = 0; root < n; ++root)
+    {
+        if (index[root] >= 0)
+            continue;
+        visit(root);
+        while (!dfs.empty())
         {
-            auto alpha = G.productions[A][p];
-            auto FIRST_alpha = FIRST_of_sequence(G, alpha);
-            for (auto it = FIRST_alpha.begin(); it != FIRST_alpha.end(); ++it)
+            int v = dfs.back().first;
+            size_t &next = dfs.back().second;
+            if (next < deps[v].size())
             {
-                string a = *it;
-                if (a == EPS)
-                    continue;
-                if (!G.table[A][a].empty() && G.table[A][a] != alpha)
+                int w = deps[v][next++];
+                if (index[w] < 0)
+                    visit(w);
+                else if (comp[w] < 0)
+                    low[v] = min(low[v], index[w]);
+                continue;
+            }
+
+            dfs.pop_back();
+            if (!dfs.empty())
+                low[dfs.back().first] = min(low[dfs.back().first], low[v]);
+            if (low[v] != index[v])
+                continue;
+            members.clear();
+            int w;
+            do
+            {
+                w = stk.back();
+                stk.pop_back();
+                comp[w] = v;
+                members.push_back(w);
+            } while (w != v);
+            for (int m : members)
+            {
+                if (m != v)
                 {
-                    ok = false;
-                    conflicts.push_back("Conflict at M[" + A + "," + a + "]");
+                    sets[v].unite(sets[m]);
+                    ++unions;
                 }
+                for (int d : deps[m])
+                {
+                    if (comp[d] != v)
+                    {
+                        sets[v].unite(sets[d]);
+                        ++unions;
+                    }
+                }
+            }
+            for (int m : members)
+                if (m != v)
+                    sets[m] = sets[v];
+        }
+    }
+
+    return unions;
+}
 
-                G.table[A][a] = alpha;
+// Nullable nonterminals by a worklist: each production counts its
+// symbols not yet known to be nullable, and its head becomes nullable
+// when the count reaches zero. Then nullable_from for every production.
+vector<char> compute_nullable(Grammar &G)
+{
+    size_t n = G.rules.size();
+    vector<char> nullable(n, 0);
+    vector<vector<int>> pending(n);
+    vector<vector<pair<int, int>>> uses(n); // (A, p) once per occurrence
+    vector<int> work;
+    for (size_t A = 0; A < n; ++A)
+    {
+        for (size_t p = 0; p < G.rules[A].size(); ++p)
+        {
+            const vector<int> &alpha = G.rules[A][p];
+            bool hasTerminal = any_of(alpha.begin(), alpha.end(), [](int X)
+                                      { return X < 0; });
+            pending[A].push_back(hasTerminal ? -1 : (int)alpha.size());
+            if (hasTerminal)
+                continue;
+            for (int X : alpha)
+                uses[X].push_back({(int)A, (int)p});
+            if (alpha.empty() && !nullable[A])
+            {
+                nullable[A] = 1;
+                work.push_back((int)A);
+            }
+        }
+    }
+
+    while (!work.empty())
+    {
+        int B = work.back();
+        work.pop_back();
+        for (auto [A, p] : uses[B])
+        {
+            if (--pending[A][p] == 0 && !nullable[A])
+            {
+                nullable[A] = 1;
+                work.push_back(A);
             }
+        }
+    }
 
-            if (FIRST_alpha.count(EPS))
+    G.nullable_from.assign(n, {});
+    for (size_t A = 0; A < n; ++A)
+    {
+        for (const vector<int> &alpha : G.rules[A])
+        {
+            int i = (int)alpha.size();
+            while (i > 0 && alpha[i - 1] >= 0 && nullable[alpha[i - 1]])
+                --i;
+            G.nullable_from[A].push_back(i);
+        }
+    }
+
+    return nullable;
+}
+
+// FIRST(A) takes the terminals that can begin A directly, and includes
+// FIRST(B) for each B reachable past a nullable prefix of one of its
+// productions. Returns the number of set unions.
+long compute_FIRST(Grammar &G)
+{
+    size_t n = G.rules.size();
+    vector<char> nullable = compute_nullable(G);
+    G.FIRST.assign(n, empty_set(G));
+    vector<vector<int>> deps(n);
+    for (size_t A = 0; A < n; ++A)
+    {
+        for (const vector<int> &alpha : G.rules[A])
+        {
+            for (int X : alpha)
             {
-                for (auto it2 = G.FOLLOW[A].begin(); it2 != G.FOLLOW[A].end(); ++it2)
+                if (X < 0)
                 {
-                    string b = *it2;
-                    if (!G.table[A][b].empty() && G.table[A][b] != alpha)
-                    {
-                        ok = false;
-                        conflicts.push_back("Conflict at M[" + A + "," + b + "]");
-                    }
+                    G.FIRST[A].insert(~X);
+                    break;
+                }
+                deps[A].push_back(X);
+                if (!nullable[X])
+                    break;
+            }
+        }
+    }
 
-                    G.table[A][b] = alpha;
+    long unions = solve_inclusions(deps, G.FIRST);
+    for (size_t A = 0; A < n; ++A)
+        if (nullable[A])
+            G.FIRST[A].insert(G.eps_bit);
+    return unions;
+}
+
+// FOLLOW(B) takes FIRST of what follows each occurrence of B, and includes
+// FOLLOW(A) when B ends a production of A up to a nullable suffix. Each
+// production is walked once from the right, carrying FIRST of the suffix.
+// Needs compute_FIRST; returns the number of set unions.
+long compute_FOLLOW(Grammar &G)
+{
+    size_t n = G.rules.size();
+    G.FOLLOW.assign(n, empty_set(G));
+    G.FOLLOW[G.nonterminal_id.at(G.start)].insert(G.terminal_id.at(END_MARKER));
+    vector<vector<int>> deps(n);
+    TermSet suffix = empty_set(G);
+    long unions = 0;
+    for (size_t A = 0; A < n; ++A)
+    {
+        for (size_t p = 0; p < G.rules[A].size(); ++p)
+        {
+            const vector<int> &alpha = G.rules[A][p];
+            fill(suffix.words.begin(), suffix.words.end(), 0);
+            for (int i = (int)alpha.size() - 1; i >= 0; --i)
+            {
+                int X = alpha[i];
+                if (X < 0)
+                {
+                    fill(suffix.words.begin(), suffix.words.end(), 0);
+                    suffix.insert(~X);
+                    continue;
                 }
+                G.FOLLOW[X].unite(suffix);
+                ++unions;
+                if (i + 1 >= G.nullable_from[A][p])
+                    deps[X].push_back((int)A);
+                if (!G.FIRST[X].contains(G.eps_bit))
+                    fill(suffix.words.begin(), suffix.words.end(), 0);
+                suffix.unite(G.FIRST[X], G.eps_bit);
             }
         }
     }
 
+    return unions + solve_inclusions(deps, G.FOLLOW);
+}
+
+// Fill the dense table with production IDs
+bool build_LL1_table(Grammar &G, vector<string> &conflicts)
+{
+    if (G.prod_head.size() > (size_t)INT16_MAX)
+    {
+        conflicts.push_back("too many productions for a 16-bit table");
+        return false;
+    }
+
+    bool ok = true;
+    size_t T = G.terminal_names.size();
+    G.table.assign(G.rules.size() * T, -1);
+    for (size_t id = 0; id < G.prod_head.size(); ++id)
+    {
+        int A = G.prod_head[id];
+        const string &name = G.nonterminals_list[A];
+        const auto &alts = G.productions[name];
+        const vector<string> &alpha = alts[G.prod_alt[id]];
+        TermSet FIRST_alpha = FIRST_of_sequence(G, G.rules[A][G.prod_alt[id]]);
+        if (FIRST_alpha.contains(G.eps_bit))
+            FIRST_alpha.unite(G.FOLLOW[A]);
+        FIRST_alpha.for_each([&](int t)
+                             {
+            if (t == G.eps_bit)
+                return;
+            int16_t &entry = G.table[A * T + t];
+            if (entry >= 0 && alts[G.prod_alt[entry]] != alpha)
+            {
+                ok = false;
+                conflicts.push_back("Conflict at M[" + name + "," + G.terminal_names[t] + "]");
+            }
+
+            entry = (int16_t)id; });
+    }
+
     return ok;
 }
 
-template <typename T>
-vector<T> set_to_sorted_vec(const unordered_set<T> &S)
+// Table file: a TableFileHeader, then the arrays of a ParseTable (parse
+// table, production heads, push starts, pushes, name starts, name text),
+// each at the offset the header gives, in the byte order of the machine
+// that wrote it. Offsets are 8-byte aligned so a mapping of the file is
+// used in place.
+static const char TABLE_FILE_MAGIC[8] = {'L', 'A', 'B', '5', 'L', 'L', '1', '\n'};
+static const uint32_t TABLE_FILE_VERSION = 1;
+static const uint32_t TABLE_BYTE_ORDER = 0x01020304;
+
+struct TableFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder; // TABLE_BYTE_ORDER as the writer stored it
+    uint32_t terminals;
+    uint32_t nonterminals;
+    uint32_t productions;
+    int32_t start;
+    int32_t end;
+    uint32_t pushCount;
+    uint32_t nameBytes;
+    uint32_t reserved;
+    uint64_t tableOffset;
+    uint64_t prodHeadOffset;
+    uint64_t pushStartOffset;
+    uint64_t pushesOffset;
+    uint64_t nameStartOffset;
+    uint64_t nameTextOffset;
+    uint64_t fileSize;
+};
+
+// Write P as a table file
+void save_table(const ParseTable &P, const string &filename)
 {
-    vector<T> v(S.begin(), S.end());
+    auto align = [](uint64_t offset)
+    { return (offset + 7) & ~uint64_t(7); };
+    uint64_t cells = (uint64_t)P.nonterminals * P.terminals;
+    uint32_t symbols = P.terminals + P.nonterminals;
+    TableFileHeader h{};
+    memcpy(h.magic, TABLE_FILE_MAGIC, sizeof h.magic);
+    h.version = TABLE_FILE_VERSION;
+    h.byteOrder = TABLE_BYTE_ORDER;
+    h.terminals = P.terminals;
+    h.nonterminals = P.nonterminals;
+    h.productions = P.productions;
+    h.start = P.start;
+    h.end = P.end;
+    h.pushCount = P.push_start[P.productions];
+    h.nameBytes = P.name_start[symbols];
+    h.tableOffset = align(sizeof h);
+    h.prodHeadOffset = align(h.tableOffset + cells * sizeof(int16_t));
+    h.pushStartOffset = align(h.prodHeadOffset + h.productions * sizeof(int32_t));
+    h.pushesOffset = align(h.pushStartOffset + (h.productions + 1) * sizeof(int32_t));
+    h.nameStartOffset = align(h.pushesOffset + h.pushCount * sizeof(int32_t));
+    h.nameTextOffset = h.nameStartOffset + (symbols + 1) * sizeof(uint32_t);
+    h.fileSize = h.nameTextOffset + h.nameBytes;
+
+    ofstream out(filename, ios::binary);
+    if (!out)
+        throw runtime_error("cannot write '" + filename + "'");
+    auto section = [&](uint64_t offset, const void *data, size_t bytes)
+    {
+        static const char zeros[8] = {};
+        out.write(zeros, offset - (uint64_t)out.tellp());
+        out.write(static_cast<const char *>(data), bytes);
+    };
+    out.write(reinterpret_cast<const char *>(&h), sizeof h);
+    section(h.tableOffset, P.table, cells * sizeof(int16_t));
+    section(h.prodHeadOffset, P.prod_head, h.productions * sizeof(int32_t));
+    section(h.pushStartOffset, P.push_start, (h.productions + 1) * sizeof(int32_t));
+    section(h.pushesOffset, P.pushes, h.pushCount * sizeof(int32_t));
+    section(h.nameStartOffset, P.name_start, (symbols + 1) * sizeof(uint32_t));
+    section(h.nameTextOffset, P.name_text, h.nameBytes);
+    if (!out.flush())
+        throw runtime_error("cannot write '" + filename + "'");
+}
+
+// A table file mapped read-only. The header is checked, then once every
+// table cell, push and name offset, so a bad file cannot make a parse
+// read out of bounds; table() points straight into the mapping.
+class MappedTable
+{
+    void *addr = MAP_FAILED;
+    size_t size = 0;
+    ParseTable view;
+
+    // Whether the arrays of a table file whose header checked out are in
+    // range: table cells are -1 or productions, push starts and name
+    // starts rise and stay inside their sections, and heads and pushes are
+    // symbols
+    static const char *check_contents(const char *base, const TableFileHeader &h, uint64_t cells, uint64_t symbols)
+    {
+        auto array = [&](uint64_t offset)
+        { return reinterpret_cast<const int32_t *>(base + offset); };
+        const int16_t *table = reinterpret_cast<const int16_t *>(base + h.tableOffset);
+        uint16_t top = 0; // largest cell + 1
+        for (uint64_t i = 0; i < cells; ++i)
+            top = max(top, (uint16_t)(table[i] + 1));
+        if (top > h.productions)
+            return "table file has a cell out of range";
+        const int32_t *heads = array(h.prodHeadOffset), *pushStart = array(h.pushStartOffset);
+        if (pushStart[0] != 0)
+            return "table file has bad push starts";
+        for (uint32_t id = 0; id < h.productions; ++id)
+        {
+            if (heads[id] < 0 || (uint32_t)heads[id] >= h.nonterminals)
+                return "table file has a production head out of range";
+            if (pushStart[id + 1] < pushStart[id] || (uint32_t)pushStart[id + 1] > h.pushCount)
+                return "table file has bad push starts";
+        }
+        const int32_t *pushes = array(h.pushesOffset);
+        for (uint32_t i = 0; i < h.pushCount; ++i)
+            if (pushes[i] >= 0 ? (uint32_t)pushes[i] >= h.nonterminals : (uint32_t)~pushes[i] >= h.terminals)
+                return "table file has a push out of range";
+        const uint32_t *nameStart = reinterpret_cast<const uint32_t *>(base + h.nameStartOffset);
+        if (nameStart[0] != 0)
+            return "table file has bad name starts";
+        for (uint64_t k = 0; k < symbols; ++k)
+            if (nameStart[k + 1] < nameStart[k] || nameStart[k + 1] > h.nameBytes)
+                return "table file has bad name starts";
+        return nullptr;
+    }
+
+public:
+    explicit MappedTable(const string &filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw runtime_error("cannot open table file '" + filename + "'");
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(TableFileHeader))
+        {
+            size = (size_t)st.st_size;
+            addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (addr == MAP_FAILED)
+            throw runtime_error("'" + filename + "' is not a table file");
+
+        const char *base = static_cast<const char *>(addr);
+        const TableFileHeader &h = *reinterpret_cast<const TableFileHeader *>(base);
+        const char *problem = nullptr;
+        uint64_t cells = (uint64_t)h.nonterminals * h.terminals, symbols = (uint64_t)h.terminals + h.nonterminals;
+        // offset .. offset + bytes lies past the header and inside the file
+        auto fits = [&](uint64_t offset, uint64_t bytes)
+        { return offset >= sizeof(TableFileHeader) && offset <= size && bytes <= size - offset; };
+        if (memcmp(h.magic, TABLE_FILE_MAGIC, sizeof h.magic) != 0)
+            problem = "not a table file";
+        else if (h.version != TABLE_FILE_VERSION)
+            problem = "unsupported table file version";
+        else if (h.byteOrder != TABLE_BYTE_ORDER)
+            problem = "table file was written with another byte order";
+        else if (h.fileSize != size || h.start < 0 || (uint32_t)h.start >= h.nonterminals ||
+                 h.end < 0 || (uint32_t)h.end >= h.terminals || h.productions > (uint32_t)INT16_MAX ||
+                 h.tableOffset % 8 || h.prodHeadOffset % 8 || h.pushStartOffset % 8 ||
+                 h.pushesOffset % 8 || h.nameStartOffset % 8 ||
+                 !fits(h.tableOffset, cells * sizeof(int16_t)) ||
+                 !fits(h.prodHeadOffset, h.productions * sizeof(int32_t)) ||
+                 !fits(h.pushStartOffset, (h.productions + 1) * sizeof(int32_t)) ||
+                 !fits(h.pushesOffset, h.pushCount * sizeof(int32_t)) ||
+                 !fits(h.nameStartOffset, (symbols + 1) * sizeof(uint32_t)) ||
+                 !fits(h.nameTextOffset, h.nameBytes) ||
+                 h.tableOffset + cells * sizeof(int16_t) > h.prodHeadOffset ||
+                 h.prodHeadOffset + h.productions * sizeof(int32_t) > h.pushStartOffset ||
+                 h.pushStartOffset + (h.productions + 1) * sizeof(int32_t) > h.pushesOffset ||
+                 h.pushesOffset + h.pushCount * sizeof(int32_t) > h.nameStartOffset ||
+                 h.nameStartOffset + (symbols + 1) * sizeof(uint32_t) > h.nameTextOffset ||
+                 h.nameTextOffset + h.nameBytes > size)
+            problem = "table file is truncated or corrupt";
+        else
+            problem = check_contents(base, h, cells, symbols);
+        if (problem)
+        {
+            munmap(addr, size);
+            throw runtime_error("'" + filename + "': " + problem);
+        }
+        view.terminals = h.terminals;
+        view.nonterminals = h.nonterminals;
+        view.productions = h.productions;
+        view.start = h.start;
+        view.end = h.end;
+        view.table = reinterpret_cast<const int16_t *>(base + h.tableOffset);
+        view.prod_head = reinterpret_cast<const int32_t *>(base + h.prodHeadOffset);
+        view.push_start = reinterpret_cast<const int32_t *>(base + h.pushStartOffset);
+        view.pushes = reinterpret_cast<const int32_t *>(base + h.pushesOffset);
+        view.name_start = reinterpret_cast<const uint32_t *>(base + h.nameStartOffset);
+        view.name_text = base + h.nameTextOffset;
+    }
+
+    ~MappedTable() { munmap(addr, size); }
+
+    MappedTable(const MappedTable &) = delete;
+    MappedTable &operator=(const MappedTable &) = delete;
+
+    const ParseTable &table() const { return view; }
+};
+
+// Names in s in sorted order, ε included
+vector<string> set_names(const Grammar &G, const TermSet &s)
+{
+    vector<string> v;
+    s.for_each([&](int t)
+               { v.push_back(t == G.eps_bit ? EPS : G.terminal_names[t]); });
     sort(v.begin(), v.end());
     return v;
 }
@@ -273,7 +840,7 @@ void print_sets(const Grammar &G)
     for (size_t i = 0; i < G.nonterminals_list.size(); ++i)
     {
         const string &A = G.nonterminals_list[i];
-        auto v = set_to_sorted_vec(G.FIRST.at(A));
+        auto v = set_names(G, G.FIRST[i]);
         cout << "FIRST(" << A << ") = { ";
         for (size_t j = 0; j < v.size(); ++j)
         {
@@ -287,7 +854,7 @@ void print_sets(const Grammar &G)
     for (size_t i = 0; i < G.nonterminals_list.size(); ++i)
     {
         const string &A = G.nonterminals_list[i];
-        auto v = set_to_sorted_vec(G.FOLLOW.at(A));
+        auto v = set_names(G, G.FOLLOW[i]);
         cout << "FOLLOW(" << A << ") = { ";
 
         for (size_t j = 0; j < v.size(); ++j)
@@ -301,8 +868,7 @@ void print_sets(const Grammar &G)
 
 void print_table(const Grammar &G)
 {
-    vector<string> terms(G.terminals.begin(), G.terminals.end());
-    sort(terms.begin(), terms.end());
+    const vector<string> &terms = G.terminal_names;
     cout << "\nLL(1) Parsing Table M[A, a]:\n";
     cout << setw(12) << " ";
     for (size_t i = 0; i < terms.size(); ++i)
@@ -314,25 +880,9 @@ void print_table(const Grammar &G)
         cout << setw(12) << A;
         for (size_t j = 0; j < terms.size(); ++j)
         {
-            const string &a = terms[j];
-            auto itA = G.table.find(A);
-            if (itA != G.table.end())
-            {
-                auto itB = itA->second.find(a);
-                if (itB != itA->second.end() && !itB->second.empty())
-                {
-                    string rhs;
-                    for (size_t k = 0; k < itB->second.size(); ++k)
-                        rhs += (rhs.empty() ? "" : " ") + itB->second[k];
-                    cout << setw(12) << (A + "->" + (rhs.empty() ? EPS : rhs));
-                }
-
-                else
-                {
-                    cout << setw(12) << "-";
-                }
-            }
-
+            int id = G.table[idx * terms.size() + j];
+            if (id >= 0)
+                cout << setw(12) << (A + "->" + production_rhs(parse_table(G), id));
             else
                 cout << setw(12) << "-";
         }
@@ -387,12 +937,12 @@ string join_tokens(const vector<string> &v, size_t from = 0)
     return out;
 }
 
-string stack_to_string(const vector<string> &st)
+string stack_to_string(const ParseTable &P, const vector<int> &st)
 {
     string s;
     for (size_t i = 0; i < st.size(); ++i)
     {
-        s += st[i];
+        s += symbol_name(P, st[i]);
         if (i + 1 < st.size())
             s += " ";
     }
@@ -400,81 +950,140 @@ string stack_to_string(const vector<string> &st)
     return s;
 }
 
+// Terminal IDs of the tokens; -1 for a token that is no terminal
+vector<int> token_ids(const ParseTable &P, const vector<string> &tokens)
+{
+    vector<int> ids;
+    ids.reserve(tokens.size());
+    for (const string &tok : tokens)
+        ids.push_back(terminal_id(P, tok));
+
+    return ids;
+}
+
 struct ParseResult
 {
     bool accepted;
     string errorMsg;
 };
-ParseResult predictive_parse(Grammar &G, const vector<string> &input_tokens)
+
+// One step of predictive_parse: the production expanded, the terminal
+// matched, ACCEPT, or the error that stopped the parse
+struct ParseAction
 {
-    vector<string> stk;
-    stk.push_back(END_MARKER);
-    stk.push_back(G.start);
-    vector<string> tokens = input_tokens;
-    tokens.push_back(END_MARKER);
+    enum Kind
+    {
+        EXPAND,
+        MATCH,
+        ACCEPT,
+        NO_RULE,
+        MISMATCH,
+    } kind;
+    int symbol; // the stack top
+    int arg;    // EXPAND: production ID; otherwise the lookahead, -1 if no terminal
+};
+
+// The action as the trace table shows it; lookahead is the input token's
+// text, which an unknown token has no ID for
+string action_text(const ParseTable &P, const ParseAction &act, const string &lookahead)
+{
+    switch (act.kind)
+    {
+    case ParseAction::EXPAND:
+        return "expand " + string(symbol_name(P, act.symbol)) + " -> " + production_rhs(P, act.arg);
+    case ParseAction::MATCH:
+        return "match " + lookahead;
+    case ParseAction::ACCEPT:
+        return "ACCEPT";
+    case ParseAction::NO_RULE:
+        return "ERROR: no rule for M[" + string(symbol_name(P, act.symbol)) + "," + lookahead + "]";
+    case ParseAction::MISMATCH:
+        return "ERROR: terminal mismatch. On stack: '" + string(symbol_name(P, act.symbol)) + "', lookahead: '" + lookahead + "'";
+    }
+    return "";
+}
+
+// Called at each step of predictive_parse with the stack (bottom first),
+// the input position and the action, as the trace table shows them:
+// before a match, an error or ACCEPT, after an expansion
+using ParseHook = function<void(const vector<int> &stack, size_t ip, const ParseAction &action)>;
+
+// Table-driven LL(1) parse of terminal IDs, with END_MARKER implied after
+// the last one. The stack holds symbol IDs and an expansion copies the
+// production's reversed body onto it, so the loop does not allocate.
+// lexemes, when given, names the tokens in error messages; a token with
+// no terminal ID is otherwise shown as '?'.
+ParseResult predictive_parse(const ParseTable &P, const vector<int> &tokens, const ParseHook &hook = nullptr,
+                             const vector<string> *lexemes = nullptr)
+{
+    size_t T = P.terminals;
+    int end = P.end;
+    vector<int> stk;
+    stk.reserve(64);
+    stk.push_back(~end);
+    stk.push_back(P.start);
     size_t ip = 0;
-    cout << "\nParsing Trace:\n";
-    cout << left << setw(6) << "Step" << setw(35) << "Stack" << setw(30) << "Input" << "Action\n";
-    cout << string(6 + 35 + 30 + 10, '-') << "\n";
-    int step = 1;
+    auto fail = [&](ParseAction act) -> ParseResult
+    {
+        if (hook)
+            hook(stk, ip, act);
+        string lookahead = ip >= tokens.size() ? END_MARKER : lexemes ? (*lexemes)[ip]
+                                                          : tokens[ip] < 0 ? "?"
+                                                                           : string(symbol_name(P, ~tokens[ip]));
+        return {false, action_text(P, act, lookahead)};
+    };
     while (!stk.empty())
     {
-        string X = stk.back();
-        string a = tokens[ip];
-        if (X == END_MARKER && a == END_MARKER)
+        int X = stk.back();
+        int a = ip < tokens.size() ? tokens[ip] : end;
+        if (X == ~end && a == end)
         {
-            cout << left << setw(6) << step++ << setw(35) << stack_to_string(stk) << setw(30) << join_tokens(tokens, ip) << "ACCEPT\n";
+            if (hook)
+                hook(stk, ip, {ParseAction::ACCEPT, X, a});
             return {true, ""};
         }
 
-        if (!G.nonterminals.count(X))
+        if (X < 0)
         {
-            if (X == a)
-            {
-                cout << left << setw(6) << step++ << setw(35) << stack_to_string(stk) << setw(30) << join_tokens(tokens, ip) << "match " + a << "\n";
-                stk.pop_back();
-                ++ip;
-            }
-
-            else
-            {
-                string msg = "ERROR: terminal mismatch. On stack: '" + X + "', lookahead: '" + a + "'";
-                cout << left << setw(6) << step++ << setw(35) << stack_to_string(stk) << setw(30) << join_tokens(tokens, ip) << msg << "\n";
-                return {false, msg};
-            }
-        }
-
-        else
-        {
-            auto itA = G.table.find(X);
-            if (itA == G.table.end() || itA->second.find(a) == itA->second.end() || itA->second.at(a).empty())
-            {
-                string msg = "ERROR: no rule for M[" + X + "," + a + "]";
-                cout << left << setw(6) << step++ << setw(35) << stack_to_string(stk) << setw(30) << join_tokens(tokens, ip) << msg << "\n";
-                return {false, msg};
-            }
-
-            auto rhs = itA->second[a];
+            if (~X != a)
+                return fail({ParseAction::MISMATCH, X, a});
+            if (hook)
+                hook(stk, ip, {ParseAction::MATCH, X, a});
             stk.pop_back();
-            if (!(rhs.size() == 1 && rhs[0] == EPS))
-            {
-                for (int i = (int)rhs.size() - 1; i >= 0; --i)
-                    stk.push_back(rhs[i]);
-            }
-
-            string rhs_str;
-            for (size_t i = 0; i < rhs.size(); ++i)
-                rhs_str += (i ? " " : "") + rhs[i];
-            if (rhs_str.empty())
-                rhs_str = EPS;
-            cout << left << setw(6) << step++ << setw(35) << stack_to_string(stk) << setw(30) << join_tokens(tokens, ip) << "expand " + X + " -> " + rhs_str << "\n";
+            ++ip;
+            continue;
         }
+
+        int id = a < 0 ? -1 : P.table[X * T + a];
+        if (id < 0)
+            return fail({ParseAction::NO_RULE, X, a});
+        stk.pop_back();
+        stk.insert(stk.end(), P.pushes + P.push_start[id], P.pushes + P.push_start[id + 1]);
+        if (hook)
+            hook(stk, ip, {ParseAction::EXPAND, X, id});
     }
 
     string msg = "ERROR: stack emptied without acceptance.";
     return {false, msg};
 }
 
+// predictive_parse on token strings, printing the trace as it goes
+ParseResult trace_parse(const ParseTable &P, const vector<string> &input_tokens)
+{
+    vector<string> tokens = input_tokens;
+    tokens.push_back(END_MARKER);
+    cout << "\nParsing Trace:\n";
+    cout << left << setw(6) << "Step" << setw(35) << "Stack" << setw(30) << "Input" << "Action\n";
+    cout << string(6 + 35 + 30 + 10, '-') << "\n";
+    int step = 1;
+    auto print = [&](const vector<int> &stk, size_t ip, const ParseAction &act)
+    {
+        cout << left << setw(6) << step++ << setw(35) << stack_to_string(P, stk) << setw(30)
+             << join_tokens(tokens, ip) << action_text(P, act, tokens[ip]) << "\n";
+    };
+    return predictive_parse(P, token_ids(P, input_tokens), print, &input_tokens);
+}
+
 void print_summary_and_table(Grammar &G, bool showTable = true)
 {
     compute_FIRST(G);
@@ -498,12 +1107,10 @@ void print_summary_and_table(Grammar &G, bool showTable = true)
         print_table(G);
 }
 
-int main()
+// Hardcoded grammar for the given task
+Grammar make_expression_grammar()
 {
-    ios::sync_with_stdio(false);
-    cin.tie(NULL);
     Grammar G;
-    // Hardcoded grammar for the given task
     G.start = "E";
     G.productions["E"] = {{"T", "E'"}};
     G.productions["E'"] = {{"+", "T", "E'"}, {EPS}};
@@ -513,6 +1120,592 @@ int main()
     G.nonterminals = {"E", "E'", "T", "T'", "F"};
     G.nonterminals_list = {"E", "E'", "T", "T'", "F"};
     collect_terminals(G);
+    intern_symbols(G);
+    return G;
+}
+
+// LL(1) grammar shaped like a C statement grammar: statements introduced
+// by `statements` keywords over an expression grammar `levels` binary
+// precedence levels deep, each level with its own operator. shuffled
+// lists the nonterminals in random order, which is what sweeps are
+// sensitive to.
+Grammar make_layered_grammar(int levels, int statements, bool shuffled = false)
+{
+    Grammar G;
+    auto E = [](int i)
+    { return "E" + to_string(i); };
+    auto R = [](int i)
+    { return "R" + to_string(i); };
+    auto add = [&](const string &A, vector<vector<string>> alts)
+    {
+        G.nonterminals_list.push_back(A);
+        G.nonterminals.insert(A);
+        G.productions[A] = alts;
+    };
+
+    G.start = "Program";
+    add("Program", {{"Stmts"}});
+    add("Stmts", {{"Stmt", "Stmts"}, {EPS}});
+    vector<vector<string>> stmt = {{"{", "Stmts", "}"}, {E(0), ";"}};
+    for (int j = 0; j < statements; ++j)
+        stmt.push_back({"kw" + to_string(j), "Body" + to_string(j)});
+    add("Stmt", stmt);
+    for (int j = 0; j < statements; ++j)
+    {
+        if (j % 2)
+            add("Body" + to_string(j), {{"(", E(0), ")", "Stmt"}});
+        else
+            add("Body" + to_string(j), {{E(0), ";"}, {";"}});
+    }
+    for (int i = 0; i < levels; ++i)
+    {
+        add(E(i), {{E(i + 1), R(i)}});
+        add(R(i), {{"op" + to_string(i), E(i + 1), R(i)}, {EPS}});
+    }
+    add(E(levels), {{"id"}, {"num"}, {"(", E(0), ")"}, {"-", E(levels)}});
+    if (shuffled)
+    {
+        mt19937 rng(levels);
+        shuffle(G.nonterminals_list.begin(), G.nonterminals_list.end(), rng);
+    }
+    collect_terminals(G);
+    intern_symbols(G);
+    return G;
+}
+
+// Grammar file: one or more productions per line as
+//     A -> alpha | beta | ...
+// where symbols are separated by whitespace and eps, epsilon or ε stands
+// for the empty body. A line starting with | adds alternatives to the
+// previous head, and a head may appear on several lines. The first head
+// is the start symbol; every symbol that is never a head is a terminal.
+// Blank lines and lines starting with // are skipped.
+Grammar load_grammar(const string &filename)
+{
+    ifstream in(filename);
+    if (!in)
+        throw runtime_error("cannot open grammar file '" + filename + "'");
+    Grammar G;
+    string line, head;
+    for (int lineNo = 1; getline(in, line); ++lineNo)
+    {
+        string where = filename + ":" + to_string(lineNo) + ": ";
+        line = trim(line);
+        if (line.empty() || line.compare(0, 2, "//") == 0)
+            continue;
+        string rhs;
+        if (line[0] == '|')
+        {
+            if (head.empty())
+                throw runtime_error(where + "'|' before the first production");
+            rhs = line;
+        }
+        else
+        {
+            size_t arrow = line.find("->");
+            if (arrow == string::npos)
+                throw runtime_error(where + "expected 'A -> alpha'");
+            head = trim(line.substr(0, arrow));
+            if (head.empty() || head.find_first_of(" \t") != string::npos || is_epsilon_token(head) || head == END_MARKER)
+                throw runtime_error(where + "bad head '" + head + "'");
+            rhs = " | " + line.substr(arrow + 2);
+        }
+
+        if (!G.nonterminals.count(head))
+        {
+            G.nonterminals.insert(head);
+            G.nonterminals_list.push_back(head);
+        }
+
+        // rhs starts with "|", so each alternative begins at a "|"
+        auto &alts = G.productions[head];
+        for (const string &sym : split_symbols(rhs))
+        {
+            if (sym == "|")
+            {
+                if (!alts.empty() && alts.back().empty())
+                    throw runtime_error(where + "empty alternative (write eps)");
+                alts.push_back({});
+            }
+            else if (sym == END_MARKER)
+            {
+                throw runtime_error(where + "'" + END_MARKER + "' is reserved for the end of input");
+            }
+            else
+            {
+                alts.back().push_back(sym);
+            }
+        }
+        if (alts.back().empty())
+            throw runtime_error(where + "empty alternative (write eps)");
+    }
+
+    if (G.nonterminals_list.empty())
+        throw runtime_error("no productions in '" + filename + "'");
+    G.start = G.nonterminals_list[0];
+    collect_terminals(G);
+    intern_symbols(G);
+    return G;
+}
+
+// Writes G in the format load_grammar reads, start symbol first
+void save_grammar(const Grammar &G, const string &filename)
+{
+    ofstream out(filename);
+    vector<string> order = {G.start};
+    for (const string &A : G.nonterminals_list)
+        if (A != G.start)
+            order.push_back(A);
+    for (const string &A : order)
+    {
+        out << A << " ->";
+        const auto &alts = G.productions.at(A);
+        for (size_t p = 0; p < alts.size(); ++p)
+        {
+            out << (p ? " |" : "");
+            for (const string &sym : alts[p])
+                out << " " << sym;
+        }
+        out << "\n";
+    }
+
+    if (!out)
+        throw runtime_error("cannot write '" + filename + "'");
+}
+
+// FIRST and FOLLOW by fixpoint sweeps and by the SCC solver on large
+// generated grammars, in declaration order and with the nonterminals
+// shuffled; then table construction time
+void benchmark_sets()
+{
+    using clock = chrono::steady_clock;
+    auto ms = [](clock::duration d)
+    { return chrono::duration<double, milli>(d).count(); };
+    cout << right << setw(8) << "nonterm" << setw(9) << "order"
+         << setw(8) << "passes" << setw(11) << "sweep ms" << setw(9) << "unions" << setw(9) << "scc ms"
+         << setw(8) << "passes" << setw(11) << "sweep ms" << setw(9) << "unions" << setw(9) << "scc ms"
+         << setw(10) << "table ms" << setw(6) << "same" << "\n";
+    cout << setw(17) << "" << setw(37) << string(14, '-') + " FIRST " + string(15, '-')
+         << setw(37) << string(14, '-') + " FOLLOW " + string(14, '-') << "\n";
+    for (int levels : {250, 500, 1000, 2000})
+    {
+        for (bool shuffled : {false, true})
+        {
+            Grammar G = make_layered_grammar(levels, levels / 5, shuffled);
+            auto t0 = clock::now();
+            int firstPasses = compute_FIRST_sweep(G);
+            auto t1 = clock::now();
+            int followPasses = compute_FOLLOW_sweep(G);
+            auto t2 = clock::now();
+            vector<TermSet> first = G.FIRST, follow = G.FOLLOW;
+
+            auto t3 = clock::now();
+            long firstUnions = compute_FIRST(G);
+            auto t4 = clock::now();
+            long followUnions = compute_FOLLOW(G);
+            auto t5 = clock::now();
+            bool same = true;
+            for (size_t A = 0; A < first.size(); ++A)
+                same &= first[A].words == G.FIRST[A].words && follow[A].words == G.FOLLOW[A].words;
+
+            vector<string> conflicts;
+            auto t6 = clock::now();
+            bool ok = build_LL1_table(G, conflicts);
+            auto t7 = clock::now();
+            cout << setw(8) << G.nonterminals_list.size() << setw(9) << (shuffled ? "shuffled" : "declared")
+                 << fixed << setprecision(2)
+                 << setw(8) << firstPasses << setw(11) << ms(t1 - t0) << setw(9) << firstUnions << setw(9) << ms(t4 - t3)
+                 << setw(8) << followPasses << setw(11) << ms(t2 - t1) << setw(9) << followUnions << setw(9) << ms(t5 - t4)
+                 << setw(10) << ms(t7 - t6) << setw(6) << (same && ok ? "yes" : "NO") << "\n";
+            cout.unsetf(ios::fixed);
+        }
+    }
+}
+
+// Random sentence of G with about `length` tokens: a leftmost derivation
+// that picks productions at random until that many tokens are out, then
+// finishes each nonterminal with its shortest derivation. Until then the
+// outermost nonterminal (nothing else left on the stack) never takes its
+// shortest production, so the sentence cannot end early.
+vector<int> random_sentence(const Grammar &G, size_t length, mt19937 &rng)
+{
+    size_t n = G.rules.size();
+    const long INF = LONG_MAX / 4;
+    vector<long> shortest(n, INF);
+    vector<int> shortestAlt(n, 0);
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (size_t A = 0; A < n; ++A)
+        {
+            for (size_t p = 0; p < G.rules[A].size(); ++p)
+            {
+                long len = 0;
+                for (int X : G.rules[A][p])
+                    len = min(INF, len + (X < 0 ? 1 : shortest[X]));
+                if (len < shortest[A])
+                {
+                    shortest[A] = len;
+                    shortestAlt[A] = (int)p;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    vector<int> out, stk = {G.nonterminal_id.at(G.start)};
+    while (!stk.empty())
+    {
+        int X = stk.back();
+        stk.pop_back();
+        if (X < 0)
+        {
+            out.push_back(~X);
+            continue;
+        }
+
+        int alts = (int)G.rules[X].size(), p = shortestAlt[X];
+        if (out.size() < length && stk.empty() && alts > 1)
+        {
+            p = (int)(rng() % (alts - 1));
+            p += p >= shortestAlt[X];
+        }
+        else if (out.size() < length)
+        {
+            p = (int)(rng() % alts);
+        }
+        stk.insert(stk.end(), G.rules[X][p].rbegin(), G.rules[X][p].rend());
+    }
+
+    return out;
+}
+
+// Parse throughput on random sentences of about `length` tokens, without
+// a hook and with one that only counts steps
+void benchmark_parse(size_t length)
+{
+    using clock = chrono::steady_clock;
+    mt19937 rng(13);
+    cout << left << setw(22) << "grammar" << right << setw(10) << "tokens" << setw(8) << "MB"
+         << setw(10) << "ms" << setw(12) << "M tokens/s" << setw(8) << "MB/s"
+         << setw(12) << "hooked ms" << setw(10) << "accepted" << "\n";
+    vector<pair<string, Grammar>> grammars;
+    grammars.push_back({"expression", make_expression_grammar()});
+    grammars.push_back({"layered 10 x 20", make_layered_grammar(10, 20)});
+    grammars.push_back({"layered 100 x 200", make_layered_grammar(100, 200)});
+    for (auto &[name, G] : grammars)
+    {
+        compute_FIRST(G);
+        compute_FOLLOW(G);
+        vector<string> conflicts;
+        build_LL1_table(G, conflicts);
+        vector<int> tokens = random_sentence(G, length, rng);
+        size_t bytes = 0;
+        for (int t : tokens)
+            bytes += G.terminal_names[t].size() + 1;
+
+        auto t0 = clock::now();
+        ParseTable P = parse_table(G);
+        ParseResult plain = predictive_parse(P, tokens);
+        double secs = chrono::duration<double>(clock::now() - t0).count();
+        long steps = 0;
+        auto t1 = clock::now();
+        ParseResult hooked = predictive_parse(P, tokens, [&](const vector<int> &, size_t, const ParseAction &)
+                                              { ++steps; });
+        double hookedSecs = chrono::duration<double>(clock::now() - t1).count();
+
+        double mb = bytes / (1024.0 * 1024.0);
+        cout << left << setw(22) << name << right << setw(10) << tokens.size() << fixed << setprecision(1)
+             << setw(8) << mb << setw(10) << secs * 1000 << setw(12) << tokens.size() / secs / 1e6
+             << setw(8) << mb / secs << setw(12) << hookedSecs * 1000
+             << setw(10) << (plain.accepted && hooked.accepted && conflicts.empty() ? "yes" : "NO") << "\n";
+        cout.unsetf(ios::fixed);
+    }
+}
+
+// Whitespace-separated terminal names from filename as terminal IDs of P
+vector<int> load_tokens(const ParseTable &P, const string &filename)
+{
+    ifstream in(filename, ios::binary);
+    if (!in)
+        throw runtime_error("cannot open token file '" + filename + "'");
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    unordered_map<string_view, int> ids;
+    for (int t = 0; t < P.terminals; ++t)
+        if (t != P.end)
+            ids[symbol_name(P, ~t)] = t;
+    vector<int> tokens;
+    tokens.reserve(text.size() / 4);
+    int lineNo = 1;
+    for (size_t i = 0; i < text.size();)
+    {
+        if (isspace((unsigned char)text[i]))
+        {
+            lineNo += text[i++] == '\n';
+            continue;
+        }
+
+        size_t j = i;
+        while (j < text.size() && !isspace((unsigned char)text[j]))
+            ++j;
+        string_view tok(text.data() + i, j - i);
+        auto it = ids.find(tok);
+        if (it == ids.end())
+            throw runtime_error(filename + ":" + to_string(lineNo) + ": '" + string(tok) + "' is not a terminal of the grammar");
+        tokens.push_back(it->second);
+        i = j;
+    }
+
+    return tokens;
+}
+
+// Parses tokenFile with P, reporting read and parse times; show prints
+// the trace instead of timing the bare parser
+int parse_token_file(const ParseTable &P, const string &tokenFile, bool show)
+{
+    using clock = chrono::steady_clock;
+    auto ms = [](clock::duration d)
+    { return chrono::duration<double, milli>(d).count(); };
+    auto t0 = clock::now();
+    vector<int> tokens = load_tokens(P, tokenFile);
+    auto t1 = clock::now();
+    ParseResult res;
+    if (show)
+    {
+        vector<string> names;
+        for (int t : tokens)
+            names.push_back(string(symbol_name(P, ~t)));
+        res = trace_parse(P, names);
+    }
+    else
+    {
+        res = predictive_parse(P, tokens);
+    }
+    auto t2 = clock::now();
+
+    cout << "\nTokens '" << tokenFile << "': " << tokens.size() << " tokens" << fixed << setprecision(2)
+         << ", read " << ms(t1 - t0) << " ms, parse " << ms(t2 - t1) << " ms";
+    if (!show)
+        cout << " (" << tokens.size() / chrono::duration<double>(t2 - t1).count() / 1e6 << " M tokens/s)";
+    cout << "\n";
+    cout.unsetf(ios::fixed);
+    if (!res.accepted)
+    {
+        cout << "\nResult: REJECTED\n"
+             << res.errorMsg << "\n";
+        return 1;
+    }
+
+    cout << "\nResult: ACCEPTED\n";
+    return 0;
+}
+
+// Loads a grammar file, timing each stage of table construction, then
+// parses tokenFile with it if one is given. show prints the sets, the
+// table and the parse trace as the built-in demo does.
+int run_grammar_file(const string &grammarFile, const string &tokenFile, bool show)
+{
+    using clock = chrono::steady_clock;
+    auto ms = [](clock::duration d)
+    { return chrono::duration<double, milli>(d).count(); };
+    auto t0 = clock::now();
+    Grammar G = load_grammar(grammarFile);
+    auto t1 = clock::now();
+    compute_FIRST(G);
+    auto t2 = clock::now();
+    compute_FOLLOW(G);
+    auto t3 = clock::now();
+    vector<string> conflicts;
+    bool ok = build_LL1_table(G, conflicts);
+    auto t4 = clock::now();
+
+    cout << "Grammar '" << grammarFile << "': " << G.nonterminals_list.size() << " nonterminals, "
+         << G.terminal_names.size() << " terminals, " << G.prod_head.size() << " productions\n";
+    cout << fixed << setprecision(2);
+    cout << left << setw(10) << "  load" << right << setw(10) << ms(t1 - t0) << " ms\n";
+    cout << left << setw(10) << "  FIRST" << right << setw(10) << ms(t2 - t1) << " ms\n";
+    cout << left << setw(10) << "  FOLLOW" << right << setw(10) << ms(t3 - t2) << " ms\n";
+    cout << left << setw(10) << "  table" << right << setw(10) << ms(t4 - t3) << " ms\n";
+    cout << left << setw(10) << "  total" << right << setw(10) << ms(t4 - t0) << " ms\n";
+    cout.unsetf(ios::fixed);
+    if (show)
+        print_sets(G);
+    if (!ok)
+    {
+        cout << "\nWARNING: Grammar is NOT LL(1) (" << conflicts.size() << " conflicts):\n";
+        for (size_t i = 0; i < conflicts.size() && i < 20; ++i)
+            cout << "  - " << conflicts[i] << "\n";
+        if (conflicts.size() > 20)
+            cout << "  ... and " << conflicts.size() - 20 << " more\n";
+    }
+
+    else
+    {
+        cout << "\nGrammar appears LL(1): no table conflicts detected.\n";
+    }
+
+    if (show)
+        print_table(G);
+    if (tokenFile.empty())
+        return ok ? 0 : 1;
+    if (!ok)
+    {
+        cout << "\nNot parsing '" << tokenFile << "': the table has conflicts.\n";
+        return 1;
+    }
+
+    return parse_token_file(parse_table(G), tokenFile, show);
+}
+
+// Writes a layered grammar, and optionally a random sentence of about
+// `length` tokens of it, for --grammar to load
+void write_layered(int levels, int statements, const string &grammarFile, const string &tokenFile, size_t length)
+{
+    Grammar G = make_layered_grammar(levels, statements);
+    save_grammar(G, grammarFile);
+    if (tokenFile.empty())
+        return;
+    mt19937 rng(levels);
+    vector<int> tokens = random_sentence(G, length, rng);
+    ofstream out(tokenFile);
+    for (size_t i = 0; i < tokens.size(); ++i)
+        out << G.terminal_names[tokens[i]] << (i % 16 == 15 || i + 1 == tokens.size() ? "\n" : " ");
+    if (!out)
+        throw runtime_error("cannot write '" + tokenFile + "'");
+}
+
+// Builds the parse table for a grammar file and writes it as a table file
+int save_table_file(const string &grammarFile, const string &tableFile)
+{
+    Grammar G = load_grammar(grammarFile);
+    compute_FIRST(G);
+    compute_FOLLOW(G);
+    vector<string> conflicts;
+    if (!build_LL1_table(G, conflicts))
+        throw runtime_error("'" + grammarFile + "' is not LL(1): " + conflicts[0]);
+    save_table(parse_table(G), tableFile);
+    cout << G.nonterminals_list.size() << " nonterminals, " << G.terminal_names.size() << " terminals, "
+         << G.prod_head.size() << " productions -> " << tableFile << " (" << filesystem::file_size(tableFile) << " bytes)\n";
+    return 0;
+}
+
+// Maps a table file and parses tokenFile with it
+int parse_with_table_file(const string &tableFile, const string &tokenFile, bool show)
+{
+    auto t0 = chrono::steady_clock::now();
+    MappedTable mapped(tableFile);
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+    const ParseTable &P = mapped.table();
+    cout << "Table '" << tableFile << "': " << P.nonterminals << " nonterminals, " << P.terminals << " terminals, "
+         << P.productions << " productions, mapped in " << fixed << setprecision(1) << us << " us\n";
+    cout.unsetf(ios::fixed);
+    return parse_token_file(P, tokenFile, show);
+}
+
+// Startup cost of a parser: the grammar file loaded and FIRST, FOLLOW and
+// the table computed, against mapping the saved table file. The mapped
+// table must hold the same arrays and accept the same random sentence.
+void benchmark_startup(const string &grammarFile)
+{
+    using clock = chrono::steady_clock;
+    string dir = filesystem::temp_directory_path().string();
+    string tablePath = dir + "/lab5-startup.ll1", grammarPath = dir + "/lab5-startup.grammar";
+    mt19937 rng(17);
+    cout << left << setw(22) << "grammar" << right << setw(8) << "nonterm" << setw(8) << "prods"
+         << setw(10) << "file KB" << setw(11) << "build ms" << setw(10) << "load us"
+         << setw(10) << "speedup" << setw(8) << "agree" << "\n";
+    auto row = [&](const string &name, const string &path)
+    {
+        auto t0 = clock::now();
+        Grammar G = load_grammar(path);
+        compute_FIRST(G);
+        compute_FOLLOW(G);
+        vector<string> conflicts;
+        bool ok = build_LL1_table(G, conflicts);
+        double buildMs = chrono::duration<double, milli>(clock::now() - t0).count();
+        ParseTable P = parse_table(G);
+        save_table(P, tablePath);
+
+        // Up to 2000 loads, as many as fit in 200 ms: a load checks every cell
+        int loads = 0;
+        long productions = 0;
+        auto t1 = clock::now();
+        do
+        {
+            MappedTable mapped(tablePath);
+            productions += mapped.table().productions;
+            ++loads;
+        } while (loads < 2000 && clock::now() - t1 < chrono::milliseconds(200));
+        double loadUs = chrono::duration<double, micro>(clock::now() - t1).count() / loads;
+
+        MappedTable mapped(tablePath);
+        const ParseTable &M = mapped.table();
+        size_t cells = (size_t)P.nonterminals * P.terminals;
+        vector<int> tokens = random_sentence(G, 100000, rng);
+        bool agree = ok && productions == (long)loads * P.productions &&
+                     memcmp(M.table, P.table, cells * sizeof(int16_t)) == 0 &&
+                     memcmp(M.pushes, P.pushes, P.push_start[P.productions] * sizeof(int32_t)) == 0 &&
+                     predictive_parse(M, tokens).accepted && predictive_parse(P, tokens).accepted;
+        cout << left << setw(22) << name << right << setw(8) << P.nonterminals << setw(8) << P.productions
+             << setw(10) << filesystem::file_size(tablePath) / 1024 << fixed << setprecision(2)
+             << setw(11) << buildMs << setw(10) << loadUs << setprecision(0)
+             << setw(10) << buildMs * 1000 / loadUs << setw(8) << (agree ? "yes" : "NO") << "\n";
+        cout.unsetf(ios::fixed);
+    };
+
+    save_grammar(make_expression_grammar(), grammarPath);
+    row("expression", grammarPath);
+    for (auto [levels, statements] : {pair<int, int>{10, 20}, {100, 200}, {1000, 2000}})
+    {
+        save_grammar(make_layered_grammar(levels, statements), grammarPath);
+        row("layered " + to_string(levels) + " x " + to_string(statements), grammarPath);
+    }
+    if (!grammarFile.empty())
+        row(grammarFile, grammarFile);
+    filesystem::remove(tablePath);
+    filesystem::remove(grammarPath);
+}
+
+int main(int argc, char *argv[])
+{
+    ios::sync_with_stdio(false);
+    cin.tie(NULL);
+    if (argc == 2 && string(argv[1]) == "--bench")
+    {
+        benchmark_sets();
+        return 0;
+    }
+    if ((argc == 2 || argc == 3) && string(argv[1]) == "--bench-parse")
+    {
+        benchmark_parse(argc == 3 ? stoul(argv[2]) : 2000000);
+        return 0;
+    }
+    try
+    {
+        bool show = argc > 3 && string(argv[argc - 1]) == "--show";
+        if ((argc - show == 3 || argc - show == 4) && string(argv[1]) == "--grammar")
+            return run_grammar_file(argv[2], argc - show == 4 ? argv[3] : "", show);
+        if (argc == 4 && string(argv[1]) == "--save-table")
+            return save_table_file(argv[2], argv[3]);
+        if (argc - show == 4 && string(argv[1]) == "--parse-table")
+            return parse_with_table_file(argv[2], argv[3], show);
+        if ((argc == 2 || argc == 3) && string(argv[1]) == "--bench-startup")
+        {
+            benchmark_startup(argc == 3 ? argv[2] : "");
+            return 0;
+        }
+        if (argc >= 5 && argc <= 7 && string(argv[1]) == "--gen-layered")
+        {
+            write_layered(stoi(argv[2]), stoi(argv[3]), argv[4], argc >= 6 ? argv[5] : "", argc == 7 ? stoul(argv[6]) : 1000000);
+            return 0;
+        }
+    }
+    catch (const runtime_error &e)
+    {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    Grammar G = make_expression_grammar();
     // Print grammar summary
     print_summary_and_table(G, true);
     // Test cases
@@ -521,7 +1714,7 @@ int main()
     {
         cout << "\nParsing input: " << test << "\n";
         vector<string> tokens = lex_input(test);
-        auto res = predictive_parse(G, tokens);
+        auto res = trace_parse(parse_table(G), tokens);
         if (!res.accepted)
         {
             cout << "\nResult: REJECTED\n"